@@ -81,7 +81,10 @@ bool CMeshComponent::loadShader(char* frag_shader_path, char* vert_shader_path)
 
 void CMeshComponent::cleanup()
 {
-	SAFE_DELETE(model);
+	if (model) {
+		glmDelete(model);
+		model = NULL;
+	}
 
 	if (vertex_data_position) {
 		delete[] vertex_data_position;
@@ -96,7 +99,6 @@ void CMeshComponent::cleanup()
 	glDeleteBuffers(2, vbo);
 	glDeleteVertexArrays(1, &vao);
 
-	SAFE_DELETE(model);
 	SAFE_RELEASE_GL_SHADER(model_vert_shader);
 	SAFE_RELEASE_GL_SHADER(model_frag_shader);
 	SAFE_RELEASE_GL_PROGRAM(modelProgram);
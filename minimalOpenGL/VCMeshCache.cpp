@@ -0,0 +1,284 @@
+/*
+*  Binary cache of the per-material vertex streams VCWVObjModel builds from a .obj file.
+*
+*  Layout (native endianness, every field 4 byte aligned):
+*    header      magic "VCMC", version, option mask, number of groups, total file size
+*    sources     count, then per file: path, size, mtime (.obj and .mtl)
+*    groups      name, number of material groups, then per material group:
+*                name, diffuse[4], ambient[4], specular[4], emmissive[4], shininess,
+*                number of unique vertices, number of indices,
+*                one float stream per VC_POS/VC_NORM/VC_TEX bit, 32 bit indices
+*    strings are stored as length + bytes, padded to a multiple of 4
+*/
+
+#include "VCMeshCache.h"
+#include "helper/MappedFile.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+namespace {
+
+// bump whenever the layout or the content of the vertex streams changes
+const uint32_t MESH_CACHE_VERSION = 2;
+const char MESH_CACHE_MAGIC[4] = { 'V', 'C', 'M', 'C' };
+
+struct CacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t option;
+    uint32_t numGroups;
+    uint64_t fileSize;
+};
+
+struct SourceStamp {
+    std::string path;
+    uint64_t size;
+    int64_t mtime;
+};
+
+bool
+stampFile(const std::string &path, SourceStamp &stamp)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return false;
+    stamp.path = path;
+    stamp.size = (uint64_t)st.st_size;
+    stamp.mtime = (int64_t)st.st_mtime;
+    return true;
+}
+
+std::string
+parentPath(const std::string &path)
+{
+    auto const slashPos = path.find_last_of("/\\");
+    return slashPos == std::string::npos ? std::string("") : path.substr(0, slashPos + 1);
+}
+
+GLuint
+numStreamFloats(GLuint option, int stream, GLuint numVert)
+{
+    // stream order follows the option bits: position, normal, texCoord
+    int idx = 0;
+    if (option & VC_POS) { if (idx++ == stream) return numVert * 3; }
+    if (option & VC_NORM) { if (idx++ == stream) return numVert * 3; }
+    if (option & VC_TEX) { if (idx++ == stream) return numVert * 2; }
+    return 0;
+}
+
+int
+numStreams(GLuint option)
+{
+    return ((option & VC_POS) ? 1 : 0) + ((option & VC_NORM) ? 1 : 0) + ((option & VC_TEX) ? 1 : 0);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+class CacheWriter {
+public:
+    explicit CacheWriter(FILE *file) : m_file(file), m_ok(true) {}
+    void write(const void *data, size_t size) {
+        if (m_ok && size > 0 && fwrite(data, 1, size, m_file) != size) m_ok = false;
+    }
+    void writeU32(uint32_t v) { write(&v, sizeof(v)); }
+    void writeString(const std::string &s) {
+        static const char pad[4] = { 0, 0, 0, 0 };
+        writeU32((uint32_t)s.length());
+        write(s.data(), s.length());
+        write(pad, (4 - s.length() % 4) % 4);
+    }
+    bool ok() const { return m_ok; }
+private:
+    FILE *m_file;
+    bool m_ok;
+};
+
+class CacheReader {
+public:
+    CacheReader(const char *data, size_t size) : m_cur(data), m_end(data + size) {}
+    const char* read(size_t size) {
+        if (!m_cur || (size_t)(m_end - m_cur) < size) {
+            m_cur = nullptr;
+            return nullptr;
+        }
+        const char *p = m_cur;
+        m_cur += size;
+        return p;
+    }
+    bool readU32(uint32_t &v) {
+        const char *p = read(sizeof(v));
+        if (p) memcpy(&v, p, sizeof(v));
+        return p != nullptr;
+    }
+    bool readString(std::string &s) {
+        uint32_t length;
+        if (!readU32(length)) return false;
+        const char *p = read(length + (4 - length % 4) % 4);
+        if (p) s.assign(p, length);
+        return p != nullptr;
+    }
+    const GLfloat* readFloats(size_t count) {
+        return (const GLfloat *)read(count * sizeof(GLfloat));
+    }
+    bool ok() const { return m_cur != nullptr; }
+private:
+    const char *m_cur;
+    const char *m_end;
+};
+
+} // namespace
+
+/////////////////////////////////////////////////////////////////////////////////////////
+std::string
+vcMeshCachePath(const std::string &objPath, GLuint option)
+{
+    char optionStr[16];
+    sprintf(optionStr, ".%04x", option);
+    return objPath + optionStr + ".vccache";
+}
+
+bool
+vcReadMeshCache(const std::string &cachePath, const std::string &objPath, GLuint option,
+    std::vector<VCWVObjGroup *> &groups)
+{
+    MappedFile file;
+    if (!file.open(cachePath.c_str())) return false;
+
+    CacheReader reader(file.data(), file.size());
+    const CacheHeader *header = (const CacheHeader *)reader.read(sizeof(CacheHeader));
+    if (!header || memcmp(header->magic, MESH_CACHE_MAGIC, 4) != 0 ||
+        header->version != MESH_CACHE_VERSION || header->option != option ||
+        header->fileSize != file.size()) {
+        return false;
+    }
+
+    // the cache is stale if any source file changed
+    uint32_t numSources;
+    if (!reader.readU32(numSources)) return false;
+    for (uint32_t i = 0; i < numSources; ++i) {
+        std::string path;
+        uint64_t stamp[2];
+        SourceStamp current;
+        if (!reader.readString(path)) return false;
+        const char *p = reader.read(sizeof(stamp));
+        if (!p || !stampFile(path, current)) return false;
+        memcpy(stamp, p, sizeof(stamp));
+        if (i == 0 && path != objPath) return false;
+        if (stamp[0] != current.size || (int64_t)stamp[1] != current.mtime) return false;
+    }
+
+    // parse everything first, so that a truncated cache creates no GL objects
+    struct MtlGroupData {
+        std::string name;
+        const GLfloat *material;
+        uint32_t numVert;
+        uint32_t numIndices;
+        const GLfloat *streams[3];
+        const GLuint *indices;
+    };
+    std::vector<std::pair<std::string, std::vector<MtlGroupData>>> groupData(header->numGroups);
+    for (auto &grp : groupData) {
+        uint32_t numMtlGroups;
+        if (!reader.readString(grp.first) || !reader.readU32(numMtlGroups)) return false;
+        grp.second.resize(numMtlGroups);
+        for (auto &mtlGrp : grp.second) {
+            if (!reader.readString(mtlGrp.name)) return false;
+            mtlGrp.material = reader.readFloats(17);
+            if (!reader.readU32(mtlGrp.numVert) || !reader.readU32(mtlGrp.numIndices)) return false;
+            for (int s = 0; s < numStreams(option); ++s) {
+                mtlGrp.streams[s] = reader.readFloats(numStreamFloats(option, s, mtlGrp.numVert));
+            }
+            mtlGrp.indices = (const GLuint *)reader.read((size_t)mtlGrp.numIndices * sizeof(GLuint));
+            if (!reader.ok()) return false;
+        }
+    }
+
+    // upload straight from the mapped file
+    for (auto &grp : groupData) {
+        VCWVObjGroup *wvobjGrp = new VCWVObjGroup(grp.first);
+        for (auto &mtlGrp : grp.second) {
+            VCMtlGroup *vcMtlGrp = new VCMtlGroup(mtlGrp.name, option);
+            memcpy(vcMtlGrp->m_diffuse, mtlGrp.material + 0, 4 * sizeof(GLfloat));
+            memcpy(vcMtlGrp->m_ambient, mtlGrp.material + 4, 4 * sizeof(GLfloat));
+            memcpy(vcMtlGrp->m_specular, mtlGrp.material + 8, 4 * sizeof(GLfloat));
+            memcpy(vcMtlGrp->m_emmissive, mtlGrp.material + 12, 4 * sizeof(GLfloat));
+            vcMtlGrp->m_shininess = mtlGrp.material[16];
+            vcMtlGrp->m_numVert = mtlGrp.numVert;
+            vcMtlGrp->m_numIndices = mtlGrp.numIndices;
+            vcMtlGrp->initVao(mtlGrp.streams, mtlGrp.indices);
+            wvobjGrp->m_mtlGroups.push_back(vcMtlGrp);
+        }
+        groups.push_back(wvobjGrp);
+    }
+    return true;
+}
+
+bool
+vcWriteMeshCache(const std::string &cachePath, const std::string &objPath, const GLMmodel *model,
+    GLuint option, const std::vector<VCWVObjGroup *> &groups)
+{
+    std::vector<SourceStamp> sources(1);
+    if (!stampFile(objPath, sources[0])) return false;
+    if (model->mtllibname) {
+        SourceStamp mtl;
+        if (stampFile(parentPath(objPath) + model->mtllibname, mtl)) sources.push_back(mtl);
+    }
+
+    // write to a temporary file first, so that an interrupted write never leaves a broken cache
+    std::string tmpPath = cachePath + ".tmp";
+    FILE *file = fopen(tmpPath.c_str(), "wb");
+    if (!file) {
+        std::cerr << "can't write mesh cache " << cachePath << std::endl;
+        return false;
+    }
+    CacheWriter writer(file);
+
+    CacheHeader header;
+    memcpy(header.magic, MESH_CACHE_MAGIC, 4);
+    header.version = MESH_CACHE_VERSION;
+    header.option = option;
+    header.numGroups = (uint32_t)groups.size();
+    header.fileSize = 0; // patched below
+    writer.write(&header, sizeof(header));
+
+    writer.writeU32((uint32_t)sources.size());
+    for (auto &src : sources) {
+        uint64_t stamp[2] = { src.size, (uint64_t)src.mtime };
+        writer.writeString(src.path);
+        writer.write(stamp, sizeof(stamp));
+    }
+
+    for (auto grp : groups) {
+        writer.writeString(grp->m_name);
+        writer.writeU32((uint32_t)grp->m_mtlGroups.size());
+        for (auto mtlGrp : grp->m_mtlGroups) {
+            writer.writeString(mtlGrp->m_mtlName);
+            writer.write(mtlGrp->m_diffuse, 4 * sizeof(GLfloat));
+            writer.write(mtlGrp->m_ambient, 4 * sizeof(GLfloat));
+            writer.write(mtlGrp->m_specular, 4 * sizeof(GLfloat));
+            writer.write(mtlGrp->m_emmissive, 4 * sizeof(GLfloat));
+            writer.write(&mtlGrp->m_shininess, sizeof(GLfloat));
+            writer.writeU32(mtlGrp->m_numVert);
+            writer.writeU32(mtlGrp->m_numIndices);
+            for (auto &stream : mtlGrp->data()) {
+                writer.write(stream.data(), stream.size() * sizeof(GLfloat));
+            }
+            writer.write(mtlGrp->indices().data(), mtlGrp->indices().size() * sizeof(GLuint));
+        }
+    }
+
+    header.fileSize = (uint64_t)ftell(file);
+    fseek(file, 0, SEEK_SET);
+    writer.write(&header, sizeof(header));
+    bool ok = writer.ok();
+    ok = (fclose(file) == 0) && ok;
+
+    // rename() doesn't replace existing files on Windows
+    remove(cachePath.c_str());
+    if (!ok || rename(tmpPath.c_str(), cachePath.c_str()) != 0) {
+        remove(tmpPath.c_str());
+        std::cerr << "can't write mesh cache " << cachePath << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,26 @@
+/*
+*  Binary cache of the per-material vertex streams VCWVObjModel builds from a .obj file.
+*
+*  The cache file lives next to the .obj file and is named "<objPath>.<option>.vccache",
+*  so the same .obj loaded with different VC_* options gets one cache per option mask.
+*  It is only used if its version, option mask and the size/mtime of the .obj file and
+*  its material library still match, otherwise the .obj file is parsed again and the
+*  cache is rewritten.
+*/
+
+#pragma once
+#include "VCModels.h"
+#include <string>
+#include <vector>
+
+// path of the cache file for the given .obj file and VC_* option mask
+std::string vcMeshCachePath(const std::string &objPath, GLuint option);
+
+// reads the cache and creates groups with initialized VAOs,
+// returns false (and leaves groups untouched) if the cache is missing or stale
+bool vcReadMeshCache(const std::string &cachePath, const std::string &objPath, GLuint option,
+    std::vector<VCWVObjGroup *> &groups);
+
+// writes the groups built from model, must be called before VCMtlGroup::initVao() clears the vertex data
+bool vcWriteMeshCache(const std::string &cachePath, const std::string &objPath, const GLMmodel *model,
+    GLuint option, const std::vector<VCWVObjGroup *> &groups);
@@ -7,15 +7,55 @@
 */
 
 #include <gtc/matrix_transform.hpp>
+#include <gtc/packing.hpp>
 //#include "glm/ext.hpp"
 #include "VCModels.h"
+#include "VCMeshCache.h"
+#include "helper/MeshOptimizer.h"
+#include <chrono>
+#include <limits>
+#include <set>
+#include <sys/stat.h>
+
+namespace {
+
+const char* const UNIFORM_NAMES[] = {
+    "modelMat",
+    "normalMat",
+    "leapPos",
+    "light",
+    "resolution",
+    "cameraToWorldMatrix",
+    "invProjectionMatrix",
+};
+static_assert(sizeof(UNIFORM_NAMES) / sizeof(UNIFORM_NAMES[0]) == VC_UNIFORM_COUNT,
+    "every VCUniform slot needs a name");
+
+// the .dds texcompress wrote for _texName, empty if there is none or the image changed since
+std::string
+compressedTexture(const std::string &_texName)
+{
+    auto const dotPos = _texName.find_last_of('.');
+    std::string ddsName = _texName.substr(0, dotPos) + ".dds";
+    struct stat texStat, ddsStat;
+    if (stat(ddsName.c_str(), &ddsStat) != 0) return std::string();
+    if (stat(_texName.c_str(), &texStat) == 0 && texStat.st_mtime > ddsStat.st_mtime) return std::string();
+    return ddsName;
+}
+
+} // namespace
 
 VCModel::VCModel(const std::map<std::string, GLenum> &shaderPaths,
     const std::vector<std::string> &uniformNames)
 {
     m_shaderPaths = shaderPaths;
-    for (auto i : uniformNames) {
-        m_uniformLocs[i] = 0;
+    m_shaderProg = 0;
+    m_transform = ENV_VAR.transforms.create();
+    std::fill(std::begin(m_uniformLocs), std::end(m_uniformLocs), -1);
+    for (auto &name : uniformNames) {
+        if (std::find(std::begin(UNIFORM_NAMES), std::end(UNIFORM_NAMES), name) == std::end(UNIFORM_NAMES)) {
+            std::cerr << "uniform " << name << " has no VCUniform slot and is never set" << std::endl;
+        }
     }
     if (!initShaderProg()) {
         std::cout << "init shader program failed" << std::endl;
@@ -26,86 +66,105 @@ VCModel::VCModel(const std::map<std::string, GLenum> &shaderPaths,
 
 VCModel::~VCModel()
 {
-    if (glIsProgram(m_shaderProg)) {
-        glDeleteProgram(m_shaderProg);
-    }
+    ENV_VAR.transforms.release(m_transform);
 }
 
-// could be used in refreshing shader program
+// could be used in refreshing shader program, the program is only linked
+// again if no other model shares it
 bool
 VCModel::initShaderProg()
 {
-    if (glIsProgram(m_shaderProg)) {
-        glDeleteProgram(m_shaderProg);
+    m_program.reset();
+    m_program = VC_RESOURCES.programs.acquire(vcProgramKey(m_shaderPaths),
+        [this]() { return linkShaderProg(); },
+        [](const VCProgram &program) {
+            GLint length = 0;
+            glGetProgramiv(program.id, GL_PROGRAM_BINARY_LENGTH, &length);
+            return size_t(length);
+        });
+    m_shaderProg = m_program ? m_program->id : 0;
+    if (!m_program) return false;
+
+    for (int i = 0; i < VC_UNIFORM_COUNT; ++i) {
+        m_uniformLocs[i] = glGetUniformLocation(m_shaderProg, UNIFORM_NAMES[i]);
     }
-    m_shaderProg = glCreateProgram();
+    return true;
+}
+
+std::shared_ptr<VCProgram>
+VCModel::linkShaderProg() const
+{
+    std::shared_ptr<VCProgram> program(new VCProgram(glCreateProgram()));
     for (auto i : m_shaderPaths) {
         GLuint shader = glCreateShader(i.second);
         if (!CreateShaderFromFile(i.first.c_str(), shader)) {
             std::cerr << "Loading shader " << i.first << " failed " << std::endl;
-            return false;
+            glDeleteShader(shader);
+            return nullptr;
         }
-        glAttachShader(m_shaderProg, shader);
+        glAttachShader(program->id, shader);
         glDeleteShader(shader);
     }
 
-    if (!LinkGLSLProgram(m_shaderProg))
+    if (!LinkGLSLProgram(program->id))
     {
         std::cout << "Linking shader failed " << std::endl;
-        return false;
+        return nullptr;
     }
+    return program;
+}
 
-    for (auto i : m_uniformLocs) {
-        m_uniformLocs[i.first] = glGetUniformLocation(m_shaderProg, i.first.c_str());
+void
+VCModel::setupObjectUniforms() const
+{
+    glUniformMatrix4fv(m_uniformLocs[VC_UNIFORM_MODEL_MAT], 1, GL_FALSE, &modelMat()[0][0]);
+    if (m_uniformLocs[VC_UNIFORM_NORMAL_MAT] >= 0) {
+        glUniformMatrix3fv(m_uniformLocs[VC_UNIFORM_NORMAL_MAT], 1, GL_FALSE, &normalMat()[0][0]);
     }
-    return true;
 }
 
-glm::mat4
-VCModel::modelMat() const
+bool
+VCModel::isVisible(const VCBounds &_bounds, size_t _numDraws) const
 {
-    glm::mat4 mm = glm::mat4(1.0f);
-    mm = glm::translate(mm, m_translation);
-    mm = mm * glm::mat4_cast(m_rotation);
-    mm = glm::scale(mm, m_scaleFactor);
-    return mm;
+    return isVisible(_bounds, modelMat(), _numDraws);
 }
 
-
-glm::mat3
-VCModel::normalMat() const
+bool
+VCModel::isVisible(const VCBounds &_bounds, const glm::mat4 &_modelMat, size_t _numDraws) const
 {
-    glm::mat4 mm = modelMat();
-    return glm::mat3(glm::transpose(glm::inverse(mm)));
+    if (!ENV_VAR.FRUSTUM_CULLING_ON || ENV_VAR.frustum.isVisible(_bounds, _modelMat)) return true;
+    ENV_VAR.cullStats.culled += GLuint(_numDraws);
+    return false;
 }
 
 void
 VCModel::translate(const glm::vec3 &deltaT)
 {
-    m_translation += deltaT;
+    setTranslation(ENV_VAR.transforms.translation(m_transform) + deltaT);
 }
 
 // angle in radians, 
 // looks like the glm developers confuse themselves,
 // documentation is not consistent with the actual behaviour of glm::rotate(...)
+// renormalized, rotate() is called every frame and the normal matrix assumes a pure rotation
 void
 VCModel::rotate(float angle, const glm::vec3 &axis)
 {
-    m_rotation = glm::rotate(m_rotation, angle, axis);
+    setRotation(glm::normalize(glm::rotate(ENV_VAR.transforms.rotation(m_transform), angle, axis)));
 }
 
 void
 VCModel::scale(const glm::vec3 &deltaFactor)
 {
-    m_scaleFactor += deltaFactor;
+    setScaleFactor(ENV_VAR.transforms.scaleFactor(m_transform) + deltaFactor);
 }
 
 void
 VCModel::resetTransform()
 {
-    m_rotation = glm::quat();
-    m_translation = glm::vec3(0.f, 0.f, 0.f);
-    m_scaleFactor = glm::vec3(1.f);
+    setRotation(glm::quat());
+    setTranslation(glm::vec3(0.f, 0.f, 0.f));
+    setScaleFactor(glm::vec3(1.f));
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////
@@ -118,50 +177,168 @@ VCMtlGroup::VCMtlGroup(GLMmaterial* pMtl, GLuint _option)
     std::memcpy(m_ambient, pMtl->ambient, 4 * sizeof(GLfloat));
     std::memcpy(m_emmissive, pMtl->emmissive, 4 * sizeof(GLfloat));
     m_shininess = pMtl->shininess;
+    m_mtlSlot = 0;
     m_numVert = 0;
+    m_numIndices = 0;
+    m_indexType = GL_UNSIGNED_INT;
+    m_vao = 0;
+    m_baseVertex = 0;
+    m_firstIndex = 0;
     if (m_option & VC_POS) m_data.push_back(std::vector<GLfloat>());
     if (m_option & VC_NORM) m_data.push_back(std::vector<GLfloat>());
     if (m_option & VC_TEX) m_data.push_back(std::vector<GLfloat>());
 }
 
+VCMtlGroup::VCMtlGroup(const std::string &_mtlName, GLuint _option)
+{
+    m_mtlName = _mtlName;
+    m_option = _option;
+    std::fill(m_diffuse, m_diffuse + 4, 0.f);
+    std::fill(m_specular, m_specular + 4, 0.f);
+    std::fill(m_ambient, m_ambient + 4, 0.f);
+    std::fill(m_emmissive, m_emmissive + 4, 0.f);
+    m_shininess = 0.f;
+    m_mtlSlot = 0;
+    m_numVert = 0;
+    m_numIndices = 0;
+    m_indexType = GL_UNSIGNED_INT;
+    m_vao = 0;
+    m_baseVertex = 0;
+    m_firstIndex = 0;
+}
+
 void
 VCMtlGroup::addTriangle(GLMtriangle* tri, GLMmodel *model)
 {
     for (int i = 0; i < 3; ++i) {
+        // corners sharing position, normal and texCoord index become one vertex
+        VertexKey key;
+        key.v = (m_option & VC_POS) ? (tri->vindices)[i] : 0;
+        key.n = (m_option & VC_NORM) ? (tri->nindices)[i] : 0;
+        key.t = (m_option & VC_TEX) ? (tri->tindices)[i] : 0;
+        auto inserted = m_vertexMap.insert(std::make_pair(key, m_numVert));
+        m_indices.push_back(inserted.first->second);
+        if (!inserted.second) continue;
+
         int dataIdx = 0;
         if (m_option & VC_POS) {
             for (int j = 0; j < 3; ++j) {
-                m_data[dataIdx].push_back(model->vertices[(tri->vindices)[i] * 3 + j]);
+                m_data[dataIdx].push_back(model->vertices[key.v * 3 + j]);
             }
             ++dataIdx;
         }
         if (m_option & VC_NORM) {
             for (int j = 0; j < 3; ++j) {
-                m_data[dataIdx].push_back(model->normals[(tri->nindices)[i] * 3 + j]);
+                m_data[dataIdx].push_back(model->normals[key.n * 3 + j]);
             }
             ++dataIdx;
         }
         if (m_option & VC_TEX) {
             for (int j = 0; j < 2; ++j) {
-                m_data[dataIdx].push_back(model->texcoords[(tri->tindices)[i] * 2 + j]);
+                m_data[dataIdx].push_back(model->texcoords[key.t * 2 + j]);
             }
         }
+        ++m_numVert;
     }
-    m_numVert += 3;
+    m_numIndices += 3;
+}
+
+void
+VCMtlGroup::optimize(bool overdraw)
+{
+    std::vector<size_t> hardBoundaries;
+    overdraw = overdraw && (m_option & VC_POS);
+    vcOptimizeVertexCache(m_indices.data(), m_indices.size(), m_numVert, overdraw ? &hardBoundaries : nullptr);
+    if (overdraw) {
+        vcOptimizeOverdraw(m_indices.data(), m_indices.size(), m_data[0].data(), m_numVert, hardBoundaries);
+    }
+
+    std::vector<GLuint> remap;
+    GLuint numUsed = vcOptimizeVertexFetch(m_indices.data(), m_indices.size(), m_numVert, remap);
+    for (auto &stream : m_data) {
+        size_t numComp = m_numVert > 0 ? stream.size() / m_numVert : 0;
+        std::vector<GLfloat> reordered(numUsed * numComp);
+        for (GLuint v = 0; v < m_numVert; ++v) {
+            if (remap[v] == ~0u) continue;
+            std::copy(stream.begin() + v * numComp, stream.begin() + (v + 1) * numComp,
+                reordered.begin() + remap[v] * numComp);
+        }
+        stream.swap(reordered);
+    }
+    m_numVert = numUsed;
+}
+
+size_t
+VCMtlGroup::cacheMisses() const
+{
+    return vcSimulateVertexCache(m_indices.data(), m_indices.size(), m_numVert);
 }
 
 void 
 VCMtlGroup::initVao()
 {
+    const GLfloat *streams[3];
+    for (size_t i = 0; i < m_data.size(); ++i) {
+        streams[i] = m_data[i].data();
+    }
+    initVao(streams, m_indices.data());
+    std::vector<std::vector<GLfloat>>().swap(m_data);
+    std::vector<GLuint>().swap(m_indices);
+    std::unordered_map<VertexKey, GLuint, VertexKeyHash>().swap(m_vertexMap);
+}
+
+void
+VCMtlGroup::initVao(const GLfloat* const* streams, const GLuint* indices)
+{
+    m_bounds = VCBounds((m_option & VC_POS) ? streams[0] : nullptr, m_numVert);
+    if (m_option & VC_STATIC_ARENA) {
+        std::vector<GLubyte> vertices;
+        std::vector<VCVertexAttrib> attribs;
+        packInterleaved(streams, vertices, attribs);
+        // the packing may have dropped VC_TEX_UNORM16, so the layout is taken afterwards
+        GLuint layout = m_option & (VC_POS | VC_NORM | VC_TEX | VC_COMPACT_MASK);
+        VCStaticArena &arena = VCStaticArena::get(layout, attribs, vertexSize());
+        arena.add(vertices.data(), m_numVert, indices, m_numIndices, m_baseVertex, m_firstIndex);
+        m_vao = arena.vao();
+        m_indexType = GL_UNSIGNED_INT;
+        return;
+    }
     glGenVertexArrays(1, &m_vao);
     glBindVertexArray(m_vao);
+    if (m_option & (VC_INTERLEAVED | VC_COMPACT_MASK)) {
+        initInterleavedVBO(streams);
+    }
+    else {
+        initSeparateVBOs(streams);
+    }
+
+    // the element buffer binding is part of the VAO state
+    GLuint indexBO;
+    glGenBuffers(1, &indexBO);
+    m_BOs.push_back(indexBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBO);
+    if (m_numVert <= 0x10000) {
+        std::vector<GLushort> shortIndices(indices, indices + m_numIndices);
+        m_indexType = GL_UNSIGNED_SHORT;
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_numIndices * sizeof(GLushort), shortIndices.data(), GL_STATIC_DRAW);
+    }
+    else {
+        m_indexType = GL_UNSIGNED_INT;
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_numIndices * sizeof(GLuint), indices, GL_STATIC_DRAW);
+    }
+    glBindVertexArray(0);
+}
+
+void
+VCMtlGroup::initSeparateVBOs(const GLfloat* const* streams)
+{
     int vAttrLoc = 0;
     if (m_option & VC_POS) {
         GLuint posBO;
         glGenBuffers(1, &posBO);
         m_BOs.push_back(posBO);
         glBindBuffer(GL_ARRAY_BUFFER, m_BOs[vAttrLoc]);
-        glBufferData(GL_ARRAY_BUFFER, m_numVert * 3 * sizeof(GLfloat), m_data[vAttrLoc].data(), GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, m_numVert * 3 * sizeof(GLfloat), streams[vAttrLoc], GL_STATIC_DRAW);
         glVertexAttribPointer(vAttrLoc, 3, GL_FLOAT, GL_FALSE, 0, 0);
         glEnableVertexAttribArray(vAttrLoc);
         ++vAttrLoc;
@@ -171,7 +348,7 @@ VCMtlGroup::initVao()
         glGenBuffers(1, &normBO);
         m_BOs.push_back(normBO);
         glBindBuffer(GL_ARRAY_BUFFER, m_BOs[vAttrLoc]);
-        glBufferData(GL_ARRAY_BUFFER, m_numVert * 3 * sizeof(GLfloat), m_data[vAttrLoc].data(), GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, m_numVert * 3 * sizeof(GLfloat), streams[vAttrLoc], GL_STATIC_DRAW);
         glVertexAttribPointer(vAttrLoc, 3, GL_FLOAT, GL_FALSE, 0, 0);
         glEnableVertexAttribArray(vAttrLoc);
         ++vAttrLoc;
@@ -181,14 +358,164 @@ VCMtlGroup::initVao()
         glGenBuffers(1, &texCoordBO);
         m_BOs.push_back(texCoordBO);
         glBindBuffer(GL_ARRAY_BUFFER, m_BOs[vAttrLoc]);
-        glBufferData(GL_ARRAY_BUFFER, m_numVert * 2 * sizeof(GLfloat), m_data[vAttrLoc].data(), GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, m_numVert * 2 * sizeof(GLfloat), streams[vAttrLoc], GL_STATIC_DRAW);
         glVertexAttribPointer(vAttrLoc, 2, GL_FLOAT, GL_FALSE, 0, 0);
         glEnableVertexAttribArray(vAttrLoc);
     }
-    for (auto i : m_data) {
-        i.clear();
+}
+
+namespace {
+
+// octahedral normal encoding, see octDecode() in shaders/ps_model.vert
+glm::vec2
+octEncode(glm::vec3 n)
+{
+    GLfloat l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    if (l1 == 0.f) return glm::vec2(0.f);
+    n /= l1;
+    glm::vec2 p(n.x, n.y);
+    if (n.z < 0.f) {
+        p = (1.f - glm::abs(glm::vec2(p.y, p.x))) *
+            glm::vec2(p.x >= 0.f ? 1.f : -1.f, p.y >= 0.f ? 1.f : -1.f);
     }
-    m_data.clear();
+    return p;
+}
+
+} // namespace
+
+void
+VCMtlGroup::initInterleavedVBO(const GLfloat* const* streams)
+{
+    std::vector<GLubyte> vertices;
+    std::vector<VCVertexAttrib> attribs;
+    packInterleaved(streams, vertices, attribs);
+
+    GLuint interleavedBO;
+    glGenBuffers(1, &interleavedBO);
+    m_BOs.push_back(interleavedBO);
+    glBindBuffer(GL_ARRAY_BUFFER, interleavedBO);
+    const GLuint stride = vertexSize();
+    for (GLuint vAttrLoc = 0; vAttrLoc < attribs.size(); ++vAttrLoc) {
+        const VCVertexAttrib &a = attribs[vAttrLoc];
+        glVertexAttribPointer(vAttrLoc, a.size, a.type, a.normalized, stride, (void *)(size_t)a.offset);
+        glEnableVertexAttribArray(vAttrLoc);
+    }
+    glBufferData(GL_ARRAY_BUFFER, vertices.size(), vertices.data(), GL_STATIC_DRAW);
+}
+
+void
+VCMtlGroup::packInterleaved(const GLfloat* const* streams, std::vector<GLubyte> &vertices,
+    std::vector<VCVertexAttrib> &attribs)
+{
+    int streamIdx = 0;
+    const GLfloat *pos = (m_option & VC_POS) ? streams[streamIdx++] : nullptr;
+    const GLfloat *norm = (m_option & VC_NORM) ? streams[streamIdx++] : nullptr;
+    const GLfloat *tex = (m_option & VC_TEX) ? streams[streamIdx++] : nullptr;
+
+    if (tex && (m_option & VC_TEX_UNORM16)) {
+        const GLfloat eps = 1e-4f;
+        for (GLuint i = 0; i < m_numVert * 2; ++i) {
+            if (tex[i] < -eps || tex[i] > 1.f + eps) {
+                std::cout << "material " << m_mtlName << ": tex coordinates outside [0, 1], stored as floats" << std::endl;
+                m_option &= ~VC_TEX_UNORM16;
+                break;
+            }
+        }
+    }
+
+    const GLuint stride = vertexSize();
+    vertices.assign((size_t)m_numVert * stride, 0);
+    attribs.clear();
+    GLuint offset = 0;
+
+    if (pos) {
+        for (GLuint i = 0; i < m_numVert; ++i) {
+            GLubyte *dst = vertices.data() + (size_t)i * stride + offset;
+            if (m_option & VC_POS_SNORM16) {
+                glm::uint16 p[4] = { glm::packSnorm1x16(pos[i * 3]), glm::packSnorm1x16(pos[i * 3 + 1]),
+                    glm::packSnorm1x16(pos[i * 3 + 2]), glm::packSnorm1x16(1.f) };
+                std::memcpy(dst, p, sizeof(p));
+            }
+            else if (m_option & VC_POS_HALF) {
+                glm::uint16 p[4] = { glm::packHalf1x16(pos[i * 3]), glm::packHalf1x16(pos[i * 3 + 1]),
+                    glm::packHalf1x16(pos[i * 3 + 2]), glm::packHalf1x16(1.f) };
+                std::memcpy(dst, p, sizeof(p));
+            }
+            else {
+                std::memcpy(dst, pos + i * 3, 3 * sizeof(GLfloat));
+            }
+        }
+        if (m_option & VC_POS_SNORM16) {
+            attribs.push_back({ 4, GL_SHORT, GL_TRUE, offset });
+            offset += 4 * sizeof(GLshort);
+        }
+        else if (m_option & VC_POS_HALF) {
+            attribs.push_back({ 4, GL_HALF_FLOAT, GL_FALSE, offset });
+            offset += 4 * sizeof(GLhalf);
+        }
+        else {
+            attribs.push_back({ 3, GL_FLOAT, GL_FALSE, offset });
+            offset += 3 * sizeof(GLfloat);
+        }
+    }
+    if (norm) {
+        for (GLuint i = 0; i < m_numVert; ++i) {
+            GLubyte *dst = vertices.data() + (size_t)i * stride + offset;
+            if (m_option & VC_NORM_OCT) {
+                glm::vec2 e = octEncode(glm::vec3(norm[i * 3], norm[i * 3 + 1], norm[i * 3 + 2]));
+                glm::uint16 n[2] = { glm::packSnorm1x16(e.x), glm::packSnorm1x16(e.y) };
+                std::memcpy(dst, n, sizeof(n));
+            }
+            else {
+                std::memcpy(dst, norm + i * 3, 3 * sizeof(GLfloat));
+            }
+        }
+        if (m_option & VC_NORM_OCT) {
+            attribs.push_back({ 2, GL_SHORT, GL_TRUE, offset });
+            offset += 2 * sizeof(GLshort);
+        }
+        else {
+            attribs.push_back({ 3, GL_FLOAT, GL_FALSE, offset });
+            offset += 3 * sizeof(GLfloat);
+        }
+    }
+    if (tex) {
+        for (GLuint i = 0; i < m_numVert; ++i) {
+            GLubyte *dst = vertices.data() + (size_t)i * stride + offset;
+            if (m_option & VC_TEX_UNORM16) {
+                glm::uint16 t[2] = { glm::packUnorm1x16(tex[i * 2]), glm::packUnorm1x16(tex[i * 2 + 1]) };
+                std::memcpy(dst, t, sizeof(t));
+            }
+            else {
+                std::memcpy(dst, tex + i * 2, 2 * sizeof(GLfloat));
+            }
+        }
+        if (m_option & VC_TEX_UNORM16) {
+            attribs.push_back({ 2, GL_UNSIGNED_SHORT, GL_TRUE, offset });
+            offset += 2 * sizeof(GLushort);
+        }
+        else {
+            attribs.push_back({ 2, GL_FLOAT, GL_FALSE, offset });
+            offset += 2 * sizeof(GLfloat);
+        }
+    }
+    assert(offset == stride);
+}
+
+GLuint
+VCMtlGroup::vertexSize() const
+{
+    GLuint size = 0;
+    if (m_option & VC_POS) {
+        size += (m_option & (VC_POS_HALF | VC_POS_SNORM16)) ? 4 * sizeof(GLshort) : 3 * sizeof(GLfloat);
+    }
+    if (m_option & VC_NORM) {
+        size += (m_option & VC_NORM_OCT) ? 2 * sizeof(GLshort) : 3 * sizeof(GLfloat);
+    }
+    if (m_option & VC_TEX) {
+        size += (m_option & VC_TEX_UNORM16) ? 2 * sizeof(GLushort) : 2 * sizeof(GLfloat);
+    }
+    return size;
 }
 
 VCMtlGroup::~VCMtlGroup()
@@ -197,40 +524,67 @@ VCMtlGroup::~VCMtlGroup()
         GLuint bo = m_BOs[i];
         glDeleteBuffers(1, &bo);
     }
-    glDeleteVertexArrays(1, &m_vao);
+    if (m_vao && !(m_option & VC_STATIC_ARENA)) glDeleteVertexArrays(1, &m_vao);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////
 VCWVObjGroup::VCWVObjGroup(GLMgroup *glmGrp, GLMmodel *model, GLuint _option)
 {
     m_name = std::string(glmGrp->name);
+    // material index -> material group, so the name is only looked up once per material
+    std::vector<size_t> mtlGroupOfMtl(model->nummaterials, ~size_t(0));
     for (GLuint i = 0; i < glmGrp->numtriangles; ++i) { // iterate all triangles
         GLuint TriIdx = glmGrp->triangles[i];
         GLMtriangle* pTri = model->triangles + TriIdx;
-        GLMmaterial* pMtl = model->materials + pTri->material;
-        m_mtlGroups[idxMtlGroup(pMtl, _option)]->addTriangle(pTri, model);
-    }
-    for (auto i : m_mtlGroups) {
-        i->initVao();
+        size_t &idx = mtlGroupOfMtl[pTri->material];
+        if (idx == ~size_t(0)) idx = idxMtlGroup(model->materials + pTri->material, _option);
+        m_mtlGroups[idx]->addTriangle(pTri, model);
     }
 }
 
 size_t
 VCWVObjGroup::idxMtlGroup(GLMmaterial* pMtl, GLuint _option)
 {
-    for (int i = 0; i < m_mtlGroups.size(); ++i) {
-        if (m_mtlGroups[i]->m_mtlName == std::string(pMtl->name)) return i;
-    }
+    auto found = m_mtlGroupIdx.find(pMtl->name);
+    if (found != m_mtlGroupIdx.end()) return found->second;
     m_mtlGroups.push_back(new VCMtlGroup(pMtl, _option));
+    m_mtlGroupIdx[pMtl->name] = m_mtlGroups.size() - 1;
     return m_mtlGroups.size() - 1;
 }
 
+void
+VCWVObjGroup::updateBounds()
+{
+    m_bounds = VCBounds();
+    for (auto mtlGrp : m_mtlGroups) m_bounds.merge(mtlGrp->m_bounds);
+}
+
 VCWVObjGroup::~VCWVObjGroup()
 {
     for (auto i : m_mtlGroups) delete i;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////
+VCWVObjMesh::~VCWVObjMesh()
+{
+    for (auto i : m_groups) delete i;
+}
+
+size_t
+VCWVObjMesh::bufferBytes() const
+{
+    size_t bytes = 0;
+    for (auto grp : m_groups) {
+        for (auto mtlGrp : grp->m_mtlGroups) {
+            GLuint indexSize = mtlGrp->m_indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+            bytes += (size_t)mtlGrp->m_numVert * mtlGrp->vertexSize() + (size_t)mtlGrp->m_numIndices * indexSize;
+        }
+    }
+    return bytes;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+bool VCWVObjModel::useMeshCache = true;
 
 VCWVObjModel::VCWVObjModel(const std::string &_objPath,
     const std::map<std::string, GLenum> &_shaderPaths,
@@ -240,30 +594,180 @@ VCWVObjModel::VCWVObjModel(const std::string &_objPath,
     VCModel(_shaderPaths, _uniformNames)
 {
     m_option = _option;
-    char *path = new char[_objPath.length() + 1];
-    strcpy(path, _objPath.c_str());
-    GLMmodel *model = glmReadOBJ(path);
-    delete[] path;
+    m_mtlUBO = 0;
+    m_mtlStride = 0;
+    m_leapPos = glm::vec4(0.f);
+    m_mesh = VC_RESOURCES.meshes.acquire(vcCanonicalPath(_objPath) + "|" + std::to_string(m_option),
+        [&]() { return loadMesh(_objPath, m_option); },
+        [](const VCWVObjMesh &mesh) { return mesh.bufferBytes(); });
+    m_groups = m_mesh->m_groups;
+    if (m_option & VC_MTL_MASK) {
+        initMtlUniforms();
+    }
+    if (_texSuffix != std::string("")) {
+        autoSetupTexForMtls(_objPath, _texSuffix);
+    }
+}
+
+std::shared_ptr<VCWVObjMesh>
+VCWVObjModel::loadMesh(const std::string &_objPath, GLuint _option)
+{
+    std::shared_ptr<VCWVObjMesh> mesh(new VCWVObjMesh());
+    std::vector<VCWVObjGroup *> &groups = mesh->m_groups;
+    auto startTime = std::chrono::high_resolution_clock::now();
+    std::string cachePath = vcMeshCachePath(_objPath, _option);
+    bool fromCache = useMeshCache && vcReadMeshCache(cachePath, _objPath, _option, groups);
+
+    if (!fromCache) {
+        GLMmodel *model = loadGLMmodel(_objPath, _option);
+
+        GLMgroup* group = model->groups;
+        while (group->numtriangles > 0) {
+            VCWVObjGroup *wvobjGrp = new VCWVObjGroup(group, model, _option);
+            groups.push_back(wvobjGrp);
+            group = group->next;
+        }
+        if (_option & (VC_OPTIMIZE | VC_OPTIMIZE_OVERDRAW)) {
+            optimizeGroups(groups, _option);
+        }
+        if (useMeshCache) {
+            vcWriteMeshCache(cachePath, _objPath, model, _option, groups);
+        }
+        for (auto grp : groups) {
+            for (auto mtlGrp : grp->m_mtlGroups) {
+                assert(glGetError() == GL_NONE);
+                mtlGrp->initVao();
+                assert(glGetError() == GL_NONE);
+            }
+        }
+        glmDelete(model);
+    }
+    for (auto grp : groups) {
+        grp->updateBounds();
+    }
+    double ms = std::chrono::duration<double, std::milli>(
+        std::chrono::high_resolution_clock::now() - startTime).count();
+    std::cout << "loaded model " << _objPath << (fromCache ? " from cache" : "")
+        << " in " << ms << " ms" << std::endl;
+
+    // compare against one unindexed float vertex per triangle corner
+    GLuint floatVertexSize = ((_option & VC_POS) ? 3 : 0) + ((_option & VC_NORM) ? 3 : 0) + ((_option & VC_TEX) ? 2 : 0);
+    floatVertexSize *= sizeof(GLfloat);
+    size_t numCorners = 0, numVert = 0, flatBytes = 0, indexedBytes = mesh->bufferBytes();
+    for (auto grp : groups) {
+        for (auto mtlGrp : grp->m_mtlGroups) {
+            numCorners += mtlGrp->m_numIndices;
+            numVert += mtlGrp->m_numVert;
+            flatBytes += (size_t)mtlGrp->m_numIndices * floatVertexSize;
+        }
+    }
+    if (numCorners > 0) {
+        std::cout << "  vertices " << numCorners << " -> " << numVert
+            << ", buffer bytes " << flatBytes << " -> " << indexedBytes
+            << " (" << 100.0 * (1.0 - double(indexedBytes) / double(flatBytes)) << "% saved)" << std::endl;
+    }
+    return mesh;
+}
+
+void
+VCWVObjModel::initMtlUniforms()
+{
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    alignment = std::max(alignment, 1);
+    m_mtlStride = (sizeof(VCMtlUniforms) + alignment - 1) / alignment * alignment;
+
+    // material groups of different .obj groups share the entry of their material
+    std::unordered_map<std::string, GLuint> slots;
+    std::vector<char> data;
+    for (auto grp : m_groups) {
+        for (auto mtlGrp : grp->m_mtlGroups) {
+            auto found = slots.find(mtlGrp->m_mtlName);
+            if (found != slots.end()) {
+                mtlGrp->m_mtlSlot = found->second;
+                continue;
+            }
+            mtlGrp->m_mtlSlot = (GLuint)slots.size();
+            slots[mtlGrp->m_mtlName] = mtlGrp->m_mtlSlot;
+            data.resize(data.size() + m_mtlStride, 0);
+            VCMtlUniforms *mtl = (VCMtlUniforms *)&data[data.size() - m_mtlStride];
+            std::memcpy(mtl->diffuse, mtlGrp->m_diffuse, 4 * sizeof(GLfloat));
+            std::memcpy(mtl->specular, mtlGrp->m_specular, 4 * sizeof(GLfloat));
+            std::memcpy(mtl->ambient, mtlGrp->m_ambient, 4 * sizeof(GLfloat));
+            std::memcpy(mtl->emmissive, mtlGrp->m_emmissive, 4 * sizeof(GLfloat));
+            mtl->shininess = mtlGrp->m_shininess;
+        }
+    }
+    if (data.empty()) return;
+
+    glGenBuffers(1, &m_mtlUBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_mtlUBO);
+    glBufferData(GL_UNIFORM_BUFFER, data.size(), data.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void
+VCWVObjModel::optimizeGroups(const std::vector<VCWVObjGroup *> &_groups, GLuint _option)
+{
+    auto startTime = std::chrono::high_resolution_clock::now();
+    size_t numTri = 0, numVert = 0, missesBefore = 0, missesAfter = 0;
+    for (auto grp : _groups) {
+        for (auto mtlGrp : grp->m_mtlGroups) {
+            numTri += mtlGrp->m_numIndices / 3;
+            numVert += mtlGrp->m_numVert;
+            missesBefore += mtlGrp->cacheMisses();
+            mtlGrp->optimize((_option & VC_OPTIMIZE_OVERDRAW) != 0);
+            missesAfter += mtlGrp->cacheMisses();
+        }
+    }
+    double ms = std::chrono::duration<double, std::milli>(
+        std::chrono::high_resolution_clock::now() - startTime).count();
+    if (numTri > 0) {
+        std::cout << "  ACMR " << double(missesBefore) / numTri << " -> " << double(missesAfter) / numTri
+            << ", ATVR " << double(missesBefore) / numVert << " -> " << double(missesAfter) / numVert
+            << " (optimized in " << ms << " ms)" << std::endl;
+    }
+}
+
+GLMmodel*
+VCWVObjModel::loadGLMmodel(const std::string &_objPath, GLuint _option)
+{
+    std::vector<char> path(_objPath.begin(), _objPath.end());
+    path.push_back('\0');
+    GLMmodel *model = glmReadOBJMapped(path.data());
     glmUnitize(model);
 
+    if (_option & VC_WELD) {
+        glmWeld(model, VC_WELD_EPSILON, 0);
+    }
+
     if (model->numnormals == 0) {
         glmFacetNormals(model);
-        glmVertexNormals(model, 90);
+        glmVertexNormals(model, 90, 0);
     }
+    glmPrintMemory(model);
+    return model;
+}
 
-    GLMgroup* group = model->groups;
-    while (group->numtriangles > 0) {
-        assert(glGetError() == GL_NONE);
-        VCWVObjGroup *wvobjGrp = new VCWVObjGroup(group, model, m_option);
-        assert(glGetError() == GL_NONE);
-        m_groups.push_back(wvobjGrp);
-        group = group->next;
+void
+VCWVObjModel::benchmarkMeshOptimizer(const std::string &_objPath, GLuint _option, bool _faceted)
+{
+    GLMmodel *model = loadGLMmodel(_objPath, _option);
+    if (_faceted) {
+        glmFacetNormals(model);
+        glmVertexNormals(model, 0, 0);
     }
-    SAFE_DELETE(model);
-    std::cout << "loaded model " << _objPath << std::endl;
-    if (_texSuffix != std::string("")) {
-        autoSetupTexForMtls(_objPath, _texSuffix);
+
+    if (model->numtexcoords == 0) _option &= ~VC_TEX;
+
+    std::vector<VCWVObjGroup *> groups;
+    for (GLMgroup* group = model->groups; group->numtriangles > 0; group = group->next) {
+        groups.push_back(new VCWVObjGroup(group, model, _option));
     }
+    std::cout << "mesh optimizer " << _objPath << (_faceted ? " (faceted)" : "") << std::endl;
+    optimizeGroups(groups, _option | VC_OPTIMIZE);
+    for (auto grp : groups) delete grp;
+    glmDelete(model);
 }
 
 VCWVObjGroup* 
@@ -276,72 +780,156 @@ VCWVObjModel::getGroup(const std::string &_groupName)
 }
 
 void
-VCWVObjModel::setupMtlUniforms(VCMtlGroup* _mtlGrp)
+VCWVObjModel::setupMtlPacket(VCMtlGroup* _mtlGrp, VCDrawPacket &_packet) const
 {
-    assert(glGetError() == GL_NONE);
-    if (m_option & VC_KD) {
-        glUniform4fv(m_uniformLocs["diffuse"], 1, _mtlGrp->m_diffuse);
-    }
-    if (m_option & VC_KS) {
-        glUniform4fv(m_uniformLocs["specular"], 1, _mtlGrp->m_specular);
+    _packet.vao = _mtlGrp->m_vao;
+    _packet.count = _mtlGrp->m_numIndices;
+    _packet.indexType = _mtlGrp->m_indexType;
+    _packet.baseVertex = _mtlGrp->m_baseVertex;
+    _packet.firstIndex = _mtlGrp->m_firstIndex;
+    _packet.indirect = (_mtlGrp->m_option & VC_STATIC_ARENA) != 0;
+    if (m_mtlUBO) {
+        _packet.mtlUBO = m_mtlUBO;
+        _packet.mtlOffset = _mtlGrp->m_mtlSlot * m_mtlStride;
+        _packet.mtlSize = sizeof(VCMtlUniforms);
     }
-    if (m_option & VC_KA) {
-        glUniform4fv(m_uniformLocs["ambient"], 1, _mtlGrp->m_ambient);
-    }
-    if (m_option & VC_KE) {
-        glUniform4fv(m_uniformLocs["emmissive"], 1, _mtlGrp->m_emmissive);
-    }
-    if (m_option & VC_NS) {
-        glUniform1f(m_uniformLocs["shininess"], _mtlGrp->m_shininess);
-    }
-    assert(glGetError() == GL_NONE);
+    _packet.mtlSlot = _mtlGrp->m_mtlSlot;
+    _packet.leapPos = m_leapPos;
+
+    auto found = m_texes.find(_mtlGrp->m_mtlName);
+    if (found == m_texes.end()) return;
+    const std::vector<std::shared_ptr<OGLTexture>> &texes = found->second;
+    size_t texIdx = 0;
     int texBindingLoc = 0;
-    if (m_option & VC_KD_MAP) {
-        glActiveTexture(GL_TEXTURE0 + texBindingLoc);
-        m_texes[_mtlGrp->m_mtlName][texBindingLoc]->bind();
+    if ((m_option & VC_KD_MAP) && texIdx < texes.size()) {
+        _packet.textures[texBindingLoc] = texes[texIdx]->getID();
+        _packet.texTargets[texBindingLoc] = texes[texIdx]->getTarget();
+        ++texIdx;
         ++texBindingLoc;
     }
-    if (m_option & VC_KS_MAP) {
-        glActiveTexture(GL_TEXTURE0 + texBindingLoc);
-        m_texes[_mtlGrp->m_mtlName][texBindingLoc]->bind();
-		++texBindingLoc;
+    if ((m_option & VC_KS_MAP) && texIdx < texes.size()) {
+        _packet.textures[texBindingLoc] = texes[texIdx]->getID();
+        _packet.texTargets[texBindingLoc] = texes[texIdx]->getTarget();
+        ++texIdx;
     }
 
 	// Check if there is a enhanced texture 
-	if (texBindingLoc < m_texes[_mtlGrp->m_mtlName].size()) {
-		glActiveTexture(GL_TEXTURE3);
-		m_texes[_mtlGrp->m_mtlName][texBindingLoc]->bind();
-		//glUniform1i(m_uniformLocs["enhanced_texture"], 1);
+	if (texIdx < texes.size()) {
+        _packet.textures[3] = texes[texIdx]->getID();
+        _packet.texTargets[3] = texes[texIdx]->getTarget();
 	}
+}
+
+void
+VCWVObjModel::submitGroups(VCRenderQueue &_queue, const VCDrawPacket &_base) const
+{
+    if (!m_instances.empty() && (m_option & VC_STATIC_ARENA)) {
+        submitInstancedGroups(_queue, _base);
+        return;
+    }
+    const glm::mat4 &mm = modelMat();
+    for (auto grp : m_groups) {
+        if (!isVisible(grp->m_bounds, grp->m_mtlGroups.size())) continue;
+        for (auto mtlGrp : grp->m_mtlGroups) {
+            if (grp->m_mtlGroups.size() > 1 && !isVisible(mtlGrp->m_bounds)) continue;
+            VCDrawPacket packet = _base;
+            setupMtlPacket(mtlGrp, packet);
+            packet.viewDepth = glm::length(glm::vec3(mm * glm::vec4(mtlGrp->m_bounds.center, 1.f)) - ENV_VAR.camPos);
+            _queue.submit(packet);
+        }
+    }
+}
+
+void
+VCWVObjModel::submitInstancedGroups(VCRenderQueue &_queue, const VCDrawPacket &_base) const
+{
+    std::vector<GLuint> visible;
+    for (auto grp : m_groups) {
+        for (auto mtlGrp : grp->m_mtlGroups) {
+            // instances are culled one by one, the nearest one sorts the packet
+            visible.clear();
+            GLfloat viewDepth = std::numeric_limits<GLfloat>::max();
+            for (size_t i = 0; i < numInstances(); ++i) {
+                GLuint slot = instanceSlot(i);
+                const glm::mat4 &mm = ENV_VAR.transforms.modelMat(slot);
+                if (!isVisible(mtlGrp->m_bounds, mm)) continue;
+                visible.push_back(slot);
+                viewDepth = std::min(viewDepth,
+                    glm::length(glm::vec3(mm * glm::vec4(mtlGrp->m_bounds.center, 1.f)) - ENV_VAR.camPos));
+            }
+            if (visible.empty()) continue;
+            VCDrawPacket packet = _base;
+            setupMtlPacket(mtlGrp, packet);
+            packet.viewDepth = viewDepth;
+            _queue.submit(packet, visible.data(), GLuint(visible.size()));
+        }
+    }
+}
+
+size_t
+VCWVObjModel::addInstance()
+{
+    if (!(m_option & VC_STATIC_ARENA)) {
+        std::cerr << "instances need VC_STATIC_ARENA, only the model itself is drawn" << std::endl;
+    }
+    GLuint slot = ENV_VAR.transforms.create();
+    // starts on top of the model
+    ENV_VAR.transforms.setTranslation(slot, ENV_VAR.transforms.translation(m_transform));
+    ENV_VAR.transforms.setRotation(slot, ENV_VAR.transforms.rotation(m_transform));
+    ENV_VAR.transforms.setScaleFactor(slot, ENV_VAR.transforms.scaleFactor(m_transform));
+    m_instances.push_back(slot);
+    return m_instances.size();
+}
+
+void
+VCWVObjModel::setInstanceTranslation(size_t _instance, const glm::vec3 &_translation)
+{
+    ENV_VAR.transforms.setTranslation(instanceSlot(_instance), _translation);
+}
+
+void
+VCWVObjModel::setInstanceRotation(size_t _instance, const glm::quat &_rotation)
+{
+    ENV_VAR.transforms.setRotation(instanceSlot(_instance), glm::normalize(_rotation));
+}
+
+void
+VCWVObjModel::setInstanceScaleFactor(size_t _instance, const glm::vec3 &_factor)
+{
+    ENV_VAR.transforms.setScaleFactor(instanceSlot(_instance), _factor);
+}
 
-    assert(glGetError() == GL_NONE);
+std::shared_ptr<OGLTexture>
+VCWVObjModel::loadTexture(const std::string &_texName)
+{
+    return VC_RESOURCES.textures.acquire(vcCanonicalPath(_texName),
+        [&]() {
+            std::shared_ptr<OGLTexture> tex(new OGLTexture());
+            // the scans are large, their mipmaps are built on the loader threads as well
+            tex->setFiltering(OGL_MIPMAPS_CPU, 8.f);
+            std::string ddsName = compressedTexture(_texName);
+            if (!ddsName.empty() && tex->loadCompressed(&ddsName[0])) return tex;
+            // grey until the file is decoded, a texture that fails to load stays grey
+            // and its units keep their order
+            tex->loadAsync(_texName.c_str());
+            return tex;
+        },
+        [](OGLTexture &tex) { return tex.getResidentBytes(); });
 }
 
 void
 VCWVObjModel::setupTexForAllMtls(const std::string& _texName)
 {
+    // looked up once, every material shares the same texture
+    std::shared_ptr<OGLTexture> tex = loadTexture(_texName);
+    // a material used by several groups gets it once
+    std::set<std::string> mtlNames;
     for (auto i : m_groups) {
         for (auto j : i->m_mtlGroups) {
-            //if (m_texes.find(j->m_mtlName) == m_texes.end()) {
-			if (true) {
-                std::string texName = _texName;
-                std::unique_ptr<OGLTexture> texPtr(new OGLTexture());
-                char *texNameCstr = new char[texName.length() + 1];
-                strcpy(texNameCstr, texName.c_str());
-                m_texes[j->m_mtlName].push_back(std::unique_ptr<OGLTexture>(new OGLTexture()));
-                size_t size = m_texes[j->m_mtlName].size();
-                if (!m_texes[j->m_mtlName][size-1]->load(texNameCstr)) {
-                    std::cerr << "load texture " << texName << " failed" << std::endl;
-                }
-                delete[] texNameCstr;
-                // std::vector<std::unique_ptr<OGLTexture>> texVector = {};
-                // m_texes[j->m_mtlName] = texVector;
-                
-                std::cout << "added texture " << texName << " for " << j->m_mtlName << std::endl;
-				std::cout << "Texture size: " << m_texes[j->m_mtlName].size() << std::endl;
-            }
+            if (mtlNames.insert(j->m_mtlName).second) m_texes[j->m_mtlName].push_back(tex);
         }
     }
+    std::cout << "added texture " << _texName << " for " << mtlNames.size() << " materials" << std::endl;
 }
 
 void 
@@ -356,15 +944,7 @@ VCWVObjModel::autoSetupTexForMtls(const std::string &_objPath, const std::string
         for (auto j : i->m_mtlGroups) {
             if (m_texes.find(j->m_mtlName) == m_texes.end()) {
                 std::string texName = parentPath + j->m_mtlName + _texSuffix;
-                std::unique_ptr<OGLTexture> texPtr(new OGLTexture());
-                char *texNameCstr = new char[texName.length() + 1];
-                strcpy(texNameCstr, texName.c_str());
-                m_texes[j->m_mtlName].push_back(std::unique_ptr<OGLTexture> (new OGLTexture()));
-                size_t size = m_texes[j->m_mtlName].size();
-                if (!m_texes[j->m_mtlName][size-1]->load(texNameCstr)) {
-                    std::cerr << "load texture " << texName << " failed" << std::endl;
-                }
-                delete[] texNameCstr;
+                m_texes[j->m_mtlName].push_back(loadTexture(texName));
                 // std::vector<std::unique_ptr<OGLTexture>> texVector;
                 // texVector.push_back(texPtr);
                 // m_texes[j->m_mtlName] = texVector;
@@ -391,12 +971,20 @@ VCWVObjModel::setLeapPosition(glm::vec3 pos)
 	m_leapPos = glm::vec4(pos.x, pos.y, pos.z, 1);
 }
 
+void
+VCWVObjModel::setupObjectUniforms() const
+{
+    VCModel::setupObjectUniforms();
+    glUniform4fv(m_uniformLocs[VC_UNIFORM_LEAP_POS], 1, &m_leapPos[0]);
+}
+
 
 
 VCWVObjModel::~VCWVObjModel()
 {
-    for (auto i : m_groups) {
-        delete i;
+    SAFE_RELEASE_GL_BUFFER(m_mtlUBO);
+    for (auto slot : m_instances) {
+        ENV_VAR.transforms.release(slot);
     }
 }
 
@@ -422,9 +1010,10 @@ VCText2D::update(float elapsedTime)
 void
 VCText2D::alignToCamera(glm::vec3 camPos, glm::vec3 worldUp)
 {
-    glm::vec3 textOrientation(modelMat() * glm::vec4(0.f, 0.f, -1.f, 0.f));
+    const glm::mat4 &mm = modelMat();
+    glm::vec3 textOrientation(mm * glm::vec4(0.f, 0.f, -1.f, 0.f));
     textOrientation.y = 0;
-    glm::vec3 objPos(modelMat() * glm::vec4(0.f, 0.f, 0.f, 1.f));
+    glm::vec3 objPos(mm[3]);
     glm::vec3 V = objPos - camPos;
     V.y = 0;
     if (glm::length(V) == 0.f) return;
@@ -453,34 +1042,13 @@ VCText2D::alignToCamera(glm::vec3 camPos, glm::vec3 worldUp)
 }
 
 void
-VCText2D::draw()
+VCText2D::submit(VCRenderQueue &_queue)
 {
-    assert(glGetError() == GL_NONE);
-
-    glm::mat4 mvp = ENV_VAR.projMat * ENV_VAR.viewMat * modelMat();
-    // printMat4(mvp, "MVP");
-    glDepthMask(GL_TRUE);
-    glEnable(GL_DEPTH_TEST);
-    // glDisable(GL_DEPTH_TEST);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    // glDisable(GL_BLEND);
-
-    assert(glGetError() == GL_NONE);
-
-    glUseProgram(m_shaderProg);
-
-    glUniformMatrix4fv(m_uniformLocs["MVP"], 1, GL_FALSE, &mvp[0][0]);
-    glUniform4fv(m_uniformLocs["leappos"], 1, &m_leapPos[0]);
-
-    for (auto grp : m_groups) {
-        for (auto mtlGrp : grp->m_mtlGroups) {
-            glBindVertexArray(mtlGrp->m_vao);
-            setupMtlUniforms(mtlGrp);
-			glDrawArrays(GL_TRIANGLES, 0, mtlGrp->m_numVert);
-        }
-    }
-    assert(glGetError() == GL_NONE);
+    VCDrawPacket packet;
+    packet.model = this;
+    packet.program = m_shaderProg;
+    packet.blend = VC_BLEND_ALPHA;
+    submitGroups(_queue, packet);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////
@@ -496,50 +1064,20 @@ void
 VCCh3D::update(float elapsedTime)
 {
     float rotation_speed = glm::radians(0.1f);
-    glm::vec3 axis(glm::inverse(modelMat()) * glm::vec4(0.f, 0.f, 1.f, 0.f));
+    // inverse of the model matrix applied to a direction is S^-1 * R^T = transpose(normalMat())
+    glm::vec3 axis(glm::vec3(0.f, 0.f, 1.f) * normalMat());
     rotate(rotation_speed * elapsedTime * 1000, axis);
 }
 
 void
-VCCh3D::draw()
+VCCh3D::submit(VCRenderQueue &_queue)
 {
-    glm::mat4 mm = modelMat();
-    glm::mat4 mvp = ENV_VAR.projMat * ENV_VAR.viewMat *mm;
-    glm::mat3 nm = normalMat();
-
-    glDepthMask(GL_TRUE);
-    glEnable(GL_DEPTH_TEST);
-    
-	//TODO disable, just on for having sphere indicate finger position
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-    assert(glGetError() == GL_NONE);
-
-    glUseProgram(m_shaderProg);
-    glUniformMatrix4fv(m_uniformLocs["modelMat"], 1, GL_FALSE, &mm[0][0]);
-    glUniformMatrix4fv(m_uniformLocs["MVP"], 1, GL_FALSE, &mvp[0][0]);
-    glUniformMatrix3fv(m_uniformLocs["normalMat"], 1, GL_FALSE, &nm[0][0]);
-    glUniform3fv(m_uniformLocs["camPos"], 1, &ENV_VAR.camPos[0]);
-    glm::vec3 lightPos = glm::vec3(0.f, 0.f, 0.f) + ENV_VAR.camPos;
-    glUniform3fv(m_uniformLocs["lightPos"], 1, &lightPos[0]);
-
-	glm::vec4 pos = mm * glm::vec4(ENV_VAR.camPos, 1.0);
-	//std::cout << "vsWorldPos: " << pos.x << ", " << pos.y << ", " << pos.z << std::endl;
-	//std::cout << "leapPos: " << m_leapPos.x << ", " << m_leapPos.y << ", " << m_leapPos.z << std::endl;
-
-
-    for (auto grp : m_groups) {
-        for (auto mtlGrp : grp->m_mtlGroups) {
-            glBindVertexArray(mtlGrp->m_vao);
-            setupMtlUniforms(mtlGrp);
-            glDrawArrays(GL_TRIANGLES, 0, mtlGrp->m_numVert);
-        }
-    }
-
-	glDisable(GL_BLEND);
-
-    assert(glGetError() == GL_NONE);
+    VCDrawPacket packet;
+    packet.model = this;
+    packet.program = m_shaderProg;
+	//TODO opaque, just blended for having sphere indicate finger position
+    packet.blend = VC_BLEND_ALPHA;
+    submitGroups(_queue, packet);
 }
 
 
@@ -558,43 +1096,18 @@ void
 VCPSModel::update(float elapsedTime)
 {
     float rotation_speed = glm::radians(0.1f);
-    glm::vec3 axis(glm::inverse(modelMat()) * glm::vec4(0.f, 1.f, 0.f, 0.f));
+    // inverse of the model matrix applied to a direction is S^-1 * R^T = transpose(normalMat())
+    glm::vec3 axis(glm::vec3(0.f, 1.f, 0.f) * normalMat());
     rotate(rotation_speed * elapsedTime * 1000, axis);
 }
 
 void
-VCPSModel::draw()
+VCPSModel::submit(VCRenderQueue &_queue)
 {
-    glm::mat4 mm = modelMat();
-    glm::mat4 mvp = ENV_VAR.projMat * ENV_VAR.viewMat *mm;
-    glm::mat3 nm = normalMat();
-
-    glDepthMask(GL_TRUE);
-    glEnable(GL_DEPTH_TEST);
-    glDisable(GL_BLEND);
-
-    assert(glGetError() == GL_NONE);
-
-    glUseProgram(m_shaderProg);
-    glUniformMatrix4fv(m_uniformLocs["modelMat"], 1, GL_FALSE, &mm[0][0]);
-    glUniformMatrix4fv(m_uniformLocs["MVP"], 1, GL_FALSE, &mvp[0][0]);
-    glUniformMatrix3fv(m_uniformLocs["normalMat"], 1, GL_FALSE, &nm[0][0]);
-    glUniform3fv(m_uniformLocs["camPos"], 1, &ENV_VAR.camPos[0]);
-    glm::vec3 lightPos = glm::vec3(0.f, 0.f, 0.f) + ENV_VAR.camPos;
-    glUniform3fv(m_uniformLocs["lightPos"], 1, &lightPos[0]);
-
-	glUniform4fv(m_uniformLocs["leapPos"], 1, &m_leapPos[0]);
-
-
-    for (auto grp : m_groups) {
-        for (auto mtlGrp : grp->m_mtlGroups) {
-            glBindVertexArray(mtlGrp->m_vao);
-            setupMtlUniforms(mtlGrp);
-            glDrawArrays(GL_TRIANGLES, 0, mtlGrp->m_numVert);
-        }
-    }
-
-    assert(glGetError() == GL_NONE);
+    VCDrawPacket packet;
+    packet.model = this;
+    packet.program = m_shaderProg;
+    submitGroups(_queue, packet);
 }
 
 
@@ -616,10 +1129,10 @@ Sky::draw(int windowWidth, int windowHeight, const float* cameraToWorldMatrix,
     glDisable(GL_BLEND);
     glBindVertexArray(m_vao);
     glUseProgram(m_shaderProg);
-    glUniform3fv(m_uniformLocs["light"], 1, light);
-    glUniform2f(m_uniformLocs["resolution"], float(windowWidth), float(windowHeight));
-    glUniformMatrix4fv(m_uniformLocs["cameraToWorldMatrix"], 1, GL_TRUE, cameraToWorldMatrix);
-    glUniformMatrix4fv(m_uniformLocs["invProjectionMatrix"], 1, GL_TRUE, projectionMatrixInverse);
+    glUniform3fv(m_uniformLocs[VC_UNIFORM_LIGHT], 1, light);
+    glUniform2f(m_uniformLocs[VC_UNIFORM_RESOLUTION], float(windowWidth), float(windowHeight));
+    glUniformMatrix4fv(m_uniformLocs[VC_UNIFORM_CAMERA_TO_WORLD], 1, GL_TRUE, cameraToWorldMatrix);
+    glUniformMatrix4fv(m_uniformLocs[VC_UNIFORM_INV_PROJECTION], 1, GL_TRUE, projectionMatrixInverse);
     glDrawArrays(GL_TRIANGLES, 0, 3);
 }
 
@@ -633,35 +1146,17 @@ SphereSky::SphereSky(const std::map<std::string, GLenum> &_shaderPaths,
 }
 
 void
-SphereSky::draw()
+SphereSky::submit(VCRenderQueue &_queue)
 {
-    assert(glGetError() == GL_NONE);
-    glDepthMask(GL_TRUE);
-    glEnable(GL_DEPTH_TEST);
-    glDisable(GL_BLEND);
-    glUseProgram(m_shaderProg);
-    glm::mat4 mvp = ENV_VAR.projMat * ENV_VAR.viewMat *modelMat();
-    glUniformMatrix4fv(m_uniformLocs["MVP"], 1, GL_FALSE, &mvp[0][0]);
-
-    GLfloat tessLvl = 16;
-    GLfloat outerLevel[4] = { tessLvl, tessLvl, tessLvl, tessLvl };
-    GLfloat innerLevel[2] = { tessLvl, tessLvl };
-
-    glPatchParameterfv(GL_PATCH_DEFAULT_OUTER_LEVEL, outerLevel);
-    glPatchParameterfv(GL_PATCH_DEFAULT_INNER_LEVEL, innerLevel);
-    glPatchParameteri(GL_PATCH_VERTICES, 3);
-
-    for (auto grp : m_groups) {
-        for (auto mtlGrp : grp->m_mtlGroups) {
-            glBindVertexArray(mtlGrp->m_vao);
-            setupMtlUniforms(mtlGrp); // for SPHERE_SKY_OPTION this line is actually not necessary
-            glActiveTexture(GL_TEXTURE0);
-            ENV_VAR.envMap.bind();
-            glDrawArrays(GL_PATCHES, 0, mtlGrp->m_numVert);
-        }
-    }
-    assert(glGetError() == GL_NONE);
-
+    VCDrawPacket packet;
+    packet.model = this;
+    packet.program = m_shaderProg;
+    packet.mode = GL_PATCHES;
+    packet.patchVertices = 3;
+    packet.tessLevel = 16;
+    packet.textures[0] = ENV_VAR.envMap.getID();
+    packet.texTargets[0] = ENV_VAR.envMap.getTarget();
+    submitGroups(_queue, packet);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////
@@ -699,6 +1194,10 @@ SkySphere::SkySphere(const std::map<std::string, GLenum> &_shaderPaths,
     glEnableVertexAttribArray(0);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, 8 * 4 * sizeof(GLuint), indices, GL_STATIC_DRAW);
+    m_bounds.min = glm::vec3(-1.f);
+    m_bounds.max = glm::vec3(1.f);
+    m_bounds.radius = 1.f;
+    m_bounds.valid = true;
 }
 
 SkySphere::~SkySphere()
@@ -709,23 +1208,20 @@ SkySphere::~SkySphere()
 }
 
 void
-SkySphere::draw()
+SkySphere::submit(VCRenderQueue &_queue)
 {
-    assert(glGetError() == GL_NONE);
-    glBindVertexArray(m_vao);
-    glUseProgram(m_shaderProg);
-    glActiveTexture(GL_TEXTURE0);
-    ENV_VAR.envMap.bind();
-    glm::mat4 mvp = ENV_VAR.projMat * ENV_VAR.viewMat *modelMat();
-    glUniformMatrix4fv(m_uniformLocs["MVP"], 1, GL_FALSE, &mvp[0][0]);
-    GLfloat tessLvl = 32;
-    GLfloat outerLevel[4] = { tessLvl, tessLvl, tessLvl, tessLvl };
-    GLfloat innerLevel[2] = { tessLvl, tessLvl };
-
-    glPatchParameterfv(GL_PATCH_DEFAULT_OUTER_LEVEL, outerLevel);
-    glPatchParameterfv(GL_PATCH_DEFAULT_INNER_LEVEL, innerLevel);
-    glPatchParameteri(GL_PATCH_VERTICES, 4);
-
-    glDrawElements(GL_PATCHES, 8 * 4, GL_UNSIGNED_INT, 0);
-    assert(glGetError() == GL_NONE);
-}
\ No newline at end of file
+    if (!isVisible(m_bounds)) return;
+    VCDrawPacket packet;
+    packet.model = this;
+    packet.program = m_shaderProg;
+    packet.vao = m_vao;
+    packet.mode = GL_PATCHES;
+    packet.count = 8 * 4;
+    packet.indexType = GL_UNSIGNED_INT;
+    packet.patchVertices = 4;
+    packet.tessLevel = 32;
+    packet.textures[0] = ENV_VAR.envMap.getID();
+    packet.texTargets[0] = ENV_VAR.envMap.getTarget();
+    packet.viewDepth = glm::length(glm::vec3(modelMat()[3]) - ENV_VAR.camPos);
+    _queue.submit(packet);
+}
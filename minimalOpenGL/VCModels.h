@@ -15,45 +15,84 @@
 #include <map>
 #include <vector>
 #include "helper/GLCommon.h"
+#include "VCRenderQueue.h"
+#include "VCStaticArena.h"
+#include "VCResourceCache.h"
 #include <algorithm>
 #include <memory>
+#include <unordered_map>
+
+// per model uniforms set on the draw path. locations are looked up once per shader program,
+// a uniform the program doesn't have gets location -1, which glUniform* ignores.
+// add a slot here and its name to UNIFORM_NAMES in VCModels.cpp before using a new uniform.
+// camera and light come from the PerView uniform block (see PerViewUniforms in GLCommon.h),
+// material values from the Material block (see VCMtlUniforms)
+enum VCUniform {
+    VC_UNIFORM_MODEL_MAT,
+    VC_UNIFORM_NORMAL_MAT,
+    VC_UNIFORM_LEAP_POS,
+    VC_UNIFORM_LIGHT,
+    VC_UNIFORM_RESOLUTION,
+    VC_UNIFORM_CAMERA_TO_WORLD,
+    VC_UNIFORM_INV_PROJECTION,
+    VC_UNIFORM_COUNT
+};
 
 class VCModel {
 public:
     // shaderPaths format: <path, shader type>
-    // names of all uniforms used in all shaders should be in uniformNames
+    // uniformNames lists the uniforms the shaders provide, each must have a VCUniform slot
     VCModel(const std::map<std::string, GLenum> &shaderPaths, 
             const std::vector<std::string> &uniformNames);
     virtual ~VCModel();
+    // the program comes from VC_RESOURCES.programs, models with the same shader files share it
     bool initShaderProg();
-    glm::mat4 modelMat() const;
-    glm::mat3 normalMat() const;
-    void setTranslation(const glm::vec3 &_translation) { m_translation = _translation; }
+    // the transform lives in ENV_VAR.transforms, the matrices are
+    // rebuilt by its update() or on the first call after the transform changed
+    const glm::mat4& modelMat() const { return ENV_VAR.transforms.modelMat(m_transform); }
+    const glm::mat3& normalMat() const { return ENV_VAR.transforms.normalMat(m_transform); }
+    void setTranslation(const glm::vec3 &_translation) { ENV_VAR.transforms.setTranslation(m_transform, _translation); }
     void translate(const glm::vec3 &deltaT);
-    void setRotation(const glm::quat &_rotation) { m_rotation = _rotation; }
+    void setRotation(const glm::quat &_rotation) { ENV_VAR.transforms.setRotation(m_transform, _rotation); }
     // angle in radians
     void rotate(float angle, const glm::vec3 &axis);
-    void setScaleFactor(const glm::vec3 &_factor) { m_scaleFactor = _factor; }
+    void setScaleFactor(const glm::vec3 &_factor) { ENV_VAR.transforms.setScaleFactor(m_transform, _factor); }
     void scale(const glm::vec3 &deltaFactor);
     void resetTransform();
+    // sets modelMat and normalMat of m_shaderProg, called by VCRenderQueue::flush()
+    virtual void setupObjectUniforms() const;
+    // slot of the transform in ENV_VAR.transforms
+    GLuint transformSlot() const { return m_transform; }
 
 protected:
-    GLuint m_shaderProg;
-    glm::quat m_rotation;
-    glm::vec3 m_translation;
-    glm::vec3 m_scaleFactor;
+    // frustum test of object space bounds against ENV_VAR.frustum,
+    // adds _numDraws to ENV_VAR.cullStats.culled if they are outside
+    bool isVisible(const VCBounds &_bounds, size_t _numDraws = 1) const;
+    // same with another transform than the one of the model
+    bool isVisible(const VCBounds &_bounds, const glm::mat4 &_modelMat, size_t _numDraws = 1) const;
+
+    GLuint m_shaderProg; // id of m_program, 0 if it failed to link
+    std::shared_ptr<VCProgram> m_program;
+    GLuint m_transform; // slot in ENV_VAR.transforms
     std::map<std::string, GLenum> m_shaderPaths;
-    std::map<std::string, GLuint> m_uniformLocs;
+    GLint m_uniformLocs[VC_UNIFORM_COUNT]; // indexed by VCUniform
 
 	OGLTexture enhanced_texture;
+
+private:
+    // compiles and links the shaders of m_shaderPaths, nullptr on failure
+    std::shared_ptr<VCProgram> linkShaderProg() const;
+
+    // the transform slot is owned by one model
+    VCModel(const VCModel &) = delete;
+    VCModel& operator=(const VCModel &) = delete;
 };
 
 /////////////////////////////////////////////////////////////////////////////////////////
 // specify what kinds of data will be read from .obj/.mtl file 
 // for all classes derived from VCWVObjModel.
-// uniform names "diffuse", "specular", "shininess", "emmissive", "ambient" in shader
-// are used exclusively for data read from .mtl file if corresponding options 
-// are turned on. 
+// the values read from the .mtl file are put into the Material uniform block
+// (see VCMtlUniforms) if any of the corresponding options is turned on.
 //
 // position, vertex attribute
 const GLuint VC_POS = 0x0001 << 0; 
@@ -62,30 +101,99 @@ const GLuint VC_NORM = 0x0001 << 1;
 // tex coordinates, vertex attribute
 const GLuint VC_TEX = 0x0001 << 2;
 
-// diffuse, a uniform named "diffuse" is expected in Shader
+// diffuse, Material block member "diffuse"
 const GLuint VC_KD = 0x0001 << 3; 
 // diffuse texture, if on, binding location is 0
 const GLuint VC_KD_MAP = 0x0001 << 4; 
-// specular, a uniform named "specular" is expected in Shader
+// specular, Material block member "specular"
 const GLuint VC_KS = 0x0001 << 5; 
 // specular texture, if on and VC_KD_MAP is also on, binding loc is 1, otherwise binding loc is 0
 const GLuint VC_KS_MAP = 0x0001 << 6; 
-// shininess exponent, a uniform named "shininess" is expected in Shader
+// shininess exponent, Material block member "shininess"
 const GLuint VC_NS = 0x0001 << 7; 
-// emmissive, a uniform named "emmissive" is expected in Shader
+// emmissive, Material block member "emmissive"
 const GLuint VC_KE = 0x0001 << 8; 
-// ambient, a uniform named "ambient" is expected in Shader
+// ambient, Material block member "ambient"
 const GLuint VC_KA = 0x0001 << 9; 
 
+// vertex layout, by default every attribute has its own VBO of floats.
+// interleave position, normal and tex coordinates in one VBO
+const GLuint VC_INTERLEAVED = 0x0001 << 10;
+// positions as 4 half floats (w = 1), implies VC_INTERLEAVED
+const GLuint VC_POS_HALF = 0x0001 << 11;
+// positions as 4 normalized shorts (w = 1), exact inside the unit box of glmUnitize, implies VC_INTERLEAVED
+const GLuint VC_POS_SNORM16 = 0x0001 << 12;
+// normals octahedral encoded in 2 normalized shorts, implies VC_INTERLEAVED.
+// the vertex shader reads a vec2 and has to decode it, see octDecode() in shaders/ps_model.vert
+const GLuint VC_NORM_OCT = 0x0001 << 13;
+// tex coordinates as 2 normalized unsigned shorts, implies VC_INTERLEAVED.
+// groups with tex coordinates outside [0, 1] fall back to floats
+const GLuint VC_TEX_UNORM16 = 0x0001 << 14;
+const GLuint VC_COMPACT_MASK = VC_POS_HALF | VC_POS_SNORM16 | VC_NORM_OCT | VC_TEX_UNORM16;
+
+// mesh optimization at load time (see helper/MeshOptimizer.h).
+// reorder triangles for the post-transform vertex cache and vertices for fetch locality
+const GLuint VC_OPTIMIZE = 0x0001 << 15;
+// additionally draw outward facing triangle clusters first, requires VC_POS, implies VC_OPTIMIZE
+const GLuint VC_OPTIMIZE_OVERDRAW = 0x0001 << 16;
+// weld positions closer than VC_WELD_EPSILON (in the unit box of glmUnitize) before
+// generating normals and building vertex buffers, e.g. to join the tiles of PhotoScan meshes
+const GLuint VC_WELD = 0x0001 << 17;
+const GLfloat VC_WELD_EPSILON = 0.00001f;
+// vertices and indices go into the VCStaticArena of their vertex layout instead of own buffers,
+// VCRenderQueue draws runs of such groups with one glMultiDrawElementsIndirect. the vertex shader
+// reads modelMat and normalMat from the DrawData storage block, see shaders/ps_model_indirect.vert.
+// implies VC_INTERLEAVED, for geometry that stays loaded until the end
+const GLuint VC_STATIC_ARENA = 0x0001 << 18;
+
+// options that need the Material uniform block
+const GLuint VC_MTL_MASK = VC_KD | VC_KS | VC_NS | VC_KE | VC_KA;
+
+// std140 layout of the Material uniform block in the shaders,
+// one entry per material of a VCWVObjModel in a single uniform buffer
+struct VCMtlUniforms {
+    GLfloat diffuse[4];
+    GLfloat specular[4];
+    GLfloat ambient[4];
+    GLfloat emmissive[4];
+    GLfloat shininess;
+    GLfloat pad[3];
+};
+static_assert(sizeof(VCMtlUniforms) == 80, "VCMtlUniforms must match the std140 layout");
+
+// binding point of the Material uniform block
+const GLuint VC_MATERIAL_BINDING = 1;
+
 /////////////////////////////////////////////////////////////////////////////////////////
 class VCMtlGroup {
 private:
-    std::vector<std::vector<GLfloat>> m_data; // 0: position, 1: normal, 2: texCoord
+    // .obj indices of one triangle corner, components not in m_option are 0
+    struct VertexKey {
+        GLuint v, n, t;
+        bool operator==(const VertexKey &o) const { return v == o.v && n == o.n && t == o.t; }
+    };
+    struct VertexKeyHash {
+        size_t operator()(const VertexKey &k) const {
+            return (size_t)k.v * 73856093u ^ (size_t)k.n * 19349663u ^ (size_t)k.t * 83492791u;
+        }
+    };
+    std::vector<std::vector<GLfloat>> m_data; // unique vertices, 0: position, 1: normal, 2: texCoord
+    std::vector<GLuint> m_indices; // 3 per triangle into m_data
+    std::unordered_map<VertexKey, GLuint, VertexKeyHash> m_vertexMap; // only while collecting triangles
+    void initSeparateVBOs(const GLfloat* const* streams);
+    void initInterleavedVBO(const GLfloat* const* streams);
+    // interleaves the streams as selected by the layout bits of m_option
+    void packInterleaved(const GLfloat* const* streams, std::vector<GLubyte> &vertices,
+        std::vector<VCVertexAttrib> &attribs);
 public:
     std::string m_mtlName;
     GLuint m_option;
-    GLuint m_numVert;
-    GLuint m_vao;
+    GLuint m_numVert; // unique vertices in the vertex buffers
+    GLuint m_numIndices;
+    GLenum m_indexType; // GL_UNSIGNED_SHORT if all indices fit, GL_UNSIGNED_INT otherwise
+    GLuint m_vao; // owned by the arena with VC_STATIC_ARENA
+    GLint m_baseVertex; // range in the arena, 0 without VC_STATIC_ARENA
+    GLuint m_firstIndex;
     std::vector<GLuint> m_BOs;
 
     GLfloat m_diffuse[4]; 
@@ -93,11 +201,27 @@ public:
     GLfloat m_specular[4];
     GLfloat m_emmissive[4];
     GLfloat m_shininess;
+    GLuint m_mtlSlot; // entry of the material in the uniform buffer of the model
+    VCBounds m_bounds; // object space, computed from the positions in initVao()
     
     VCMtlGroup(GLMmaterial* pMtl, GLuint _option);
+    // empty group, material and vertex data are filled in by the mesh cache
+    VCMtlGroup(const std::string &_mtlName, GLuint _option);
     ~VCMtlGroup();
     void addTriangle(GLMtriangle* tri, GLMmodel *model);
+    // reorders the collected triangles and vertices, has to be called before initVao()
+    void optimize(bool overdraw);
+    // vertex shader invocations of the collected triangles with a 16 entry FIFO cache
+    size_t cacheMisses() const;
+    // vertex streams collected by addTriangle, in the order of the VC_POS/VC_NORM/VC_TEX bits
+    const std::vector<std::vector<GLfloat>>& data() const { return m_data; }
+    const std::vector<GLuint>& indices() const { return m_indices; }
     void initVao();
+    // upload m_numVert vertices from external streams (one per VC_POS/VC_NORM/VC_TEX bit)
+    // and m_numIndices indices
+    void initVao(const GLfloat* const* streams, const GLuint* indices);
+    // bytes per vertex over all vertex buffers
+    GLuint vertexSize() const;
 
 };
 
@@ -106,9 +230,29 @@ class VCWVObjGroup {
 public:
     std::string m_name;
     std::vector<VCMtlGroup *> m_mtlGroups;
+    VCBounds m_bounds; // union of the material groups
+    // collects the triangles of glmGrp, VAOs are created by VCWVObjModel
     VCWVObjGroup(GLMgroup *glmGrp, GLMmodel *model, GLuint _option);
+    // empty group, filled in by the mesh cache
+    VCWVObjGroup(const std::string &_name) : m_name(_name) {}
+    // index of the material group for pMtl, created on first use
     size_t idxMtlGroup(GLMmaterial* pMtl, GLuint _option);
+    // merges the bounds of the material groups after their initVao()
+    void updateBounds();
     ~VCWVObjGroup();
+private:
+    std::unordered_map<std::string, size_t> m_mtlGroupIdx; // material name -> index in m_mtlGroups
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////
+// groups of one .obj file loaded with one option mask,
+// shared by the models through VC_RESOURCES.meshes
+class VCWVObjMesh {
+public:
+    std::vector<VCWVObjGroup *> m_groups;
+    ~VCWVObjMesh();
+    // bytes of the vertex and index buffers of all material groups
+    size_t bufferBytes() const;
 };
 
 /////////////////////////////////////////////////////////////////////////////////////////
@@ -127,18 +271,61 @@ public:
 	// set leap position
 	void setLeapPosition(glm::vec3 pos);
 
+    // also sets leapPos, indirect packets carry it in VCDrawData
+    void setupObjectUniforms() const;
+
+    // instances are copies of the model drawn with its buffers, textures and program in one
+    // instanced draw per material group. each has its own transform in ENV_VAR.transforms,
+    // instance 0 is the model itself. the transforms reach the vertex shader through the
+    // DrawData block (see shaders/ps_model_indirect.vert), so this needs VC_STATIC_ARENA.
+    // returns the index of the new instance
+    size_t addInstance();
+    size_t numInstances() const { return m_instances.size() + 1; }
+    void setInstanceTranslation(size_t _instance, const glm::vec3 &_translation);
+    void setInstanceRotation(size_t _instance, const glm::quat &_rotation);
+    void setInstanceScaleFactor(size_t _instance, const glm::vec3 &_factor);
+
+    // if true, the vertex streams are cached in "<objPath>.<option>.vccache"
+    // and read from there as long as the .obj/.mtl files don't change
+    static bool useMeshCache;
+
+    // loads the .obj file without creating GL objects and prints ACMR/ATVR
+    // before and after the VC_OPTIMIZE/VC_OPTIMIZE_OVERDRAW passes. _faceted gives every
+    // corner its facet normal, no vertex is shared and every triangle is a hard cluster
+    static void benchmarkMeshOptimizer(const std::string &_objPath, GLuint _option, bool _faceted = false);
 
     ~VCWVObjModel();
 protected:
-    std::vector<VCWVObjGroup *> m_groups;
-    std::map<std::string, std::vector<std::unique_ptr<OGLTexture>>> m_texes; // <mtl_name, texture(s)>
+    std::shared_ptr<VCWVObjMesh> m_mesh;
+    std::vector<VCWVObjGroup *> m_groups; // of m_mesh
+    std::map<std::string, std::vector<std::shared_ptr<OGLTexture>>> m_texes; // <mtl_name, texture(s)>, shared through VC_RESOURCES.textures
     GLuint m_option;
 
     VCWVObjGroup* getGroup(const std::string &_groupName);
 
-    // diffuse, specular... and texture, 
-    // the uniform names used in shader are fixed, i.e. must be "diffuse", "specular", "ambient" ...
-    void setupMtlUniforms(VCMtlGroup* _mtlGrp); 
+    // reads the .obj file and prepares it as selected in _option (unitize, weld, normals)
+    static GLMmodel* loadGLMmodel(const std::string &_objPath, GLuint _option);
+    // groups with initialized VAOs from the mesh cache or the .obj file, called on a miss of VC_RESOURCES.meshes
+    static std::shared_ptr<VCWVObjMesh> loadMesh(const std::string &_objPath, GLuint _option);
+    // texture of _texName from VC_RESOURCES.textures, loaded on first use
+    static std::shared_ptr<OGLTexture> loadTexture(const std::string &_texName);
+
+    // runs the mesh optimizations selected in _option on all material groups and prints ACMR/ATVR
+    static void optimizeGroups(const std::vector<VCWVObjGroup *> &_groups, GLuint _option);
+
+    // material block entry, VAO and textures of _mtlGrp
+    void setupMtlPacket(VCMtlGroup* _mtlGrp, VCDrawPacket &_packet) const;
+
+    // submits one packet per visible material group, based on _base
+    void submitGroups(VCRenderQueue &_queue, const VCDrawPacket &_base) const;
+    // same with the visible instances of each material group in one packet
+    void submitInstancedGroups(VCRenderQueue &_queue, const VCDrawPacket &_base) const;
+    GLuint instanceSlot(size_t _instance) const { return _instance == 0 ? m_transform : m_instances[_instance - 1]; }
+
+    // packs the materials of all material groups into m_mtlUBO, one entry per material name
+    void initMtlUniforms();
+    GLuint m_mtlUBO;
+    GLsizeiptr m_mtlStride; // bytes between entries, a multiple of GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
 
     // all mtls use the same texture
     void setupTexForAllMtls(const std::string& _texName); 
@@ -149,6 +336,7 @@ protected:
 
 	glm::vec4 m_leapPos;
 
+    std::vector<GLuint> m_instances; // transform slots of instances 1..n
 
 private:
 
@@ -167,7 +355,7 @@ public:
     ~VCText2D() {}
     void update(float elapsedTime);
     void alignToCamera(glm::vec3 viewDir, glm::vec3 worldUp);
-    void draw();
+    void submit(VCRenderQueue &_queue);
 
 private:
 
@@ -175,7 +363,7 @@ private:
 };
 
 /////////////////////////////////////////////////////////////////////////////////////////
-const GLuint VCCH3D_OPTION = VC_POS | VC_NORM | VC_KD | VC_KS | VC_NS;
+const GLuint VCCH3D_OPTION = VC_POS | VC_NORM | VC_KD | VC_KS | VC_NS | VC_OPTIMIZE_OVERDRAW;
 
 class VCCh3D : public VCWVObjModel {
 public:
@@ -184,12 +372,13 @@ public:
         const std::vector<std::string> &_uniformNames, GLuint _option = VCCH3D_OPTION);
     ~VCCh3D() {}
     void update(float elapsedTime);
-    void draw();
+    void submit(VCRenderQueue &_queue);
 };
 
 
 /////////////////////////////////////////////////////////////////////////////////////////
-const GLuint VCPSMODEL_OPTION = VC_POS | VC_NORM | VC_TEX | VC_KD_MAP;
+const GLuint VCPSMODEL_OPTION = VC_POS | VC_NORM | VC_TEX | VC_KD_MAP |
+    VC_POS_SNORM16 | VC_NORM_OCT | VC_TEX_UNORM16 | VC_OPTIMIZE_OVERDRAW | VC_WELD;
 
 // PhotoScan model
 class VCPSModel : public VCWVObjModel {
@@ -200,7 +389,7 @@ public:
         const std::string& _texSuffix, GLuint _option = VCPSMODEL_OPTION);
     ~VCPSModel() {}
     void update(float elapsedTime);
-    void draw();
+    void submit(VCRenderQueue &_queue);
 };
 
 /////////////////////////////////////////////////////////////////////////////////////////
@@ -223,7 +412,7 @@ public:
         const std::vector<std::string> &_uniformNames,
         const std::string& _sphereObjPath);
     ~SphereSky(){}
-    void draw();
+    void submit(VCRenderQueue &_queue);
 private:
 
 };
@@ -240,11 +429,12 @@ public:
     SkySphere(const std::map<std::string, GLenum> &_shaderPaths,
         const std::vector<std::string> &_uniformNames);
     ~SkySphere();
-    void draw();
+    void submit(VCRenderQueue &_queue);
 private:
     GLuint m_vao;
     GLuint m_vbo;
     GLuint m_ebo;
+    VCBounds m_bounds; // unit sphere, see shaders/sky_sphere.tes
 
 };
 
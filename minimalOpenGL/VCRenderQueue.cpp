@@ -0,0 +1,230 @@
+#include "VCRenderQueue.h"
+#include "VCModels.h"
+#include "VCStaticArena.h"
+#include <algorithm>
+#include <assert.h>
+#include <string.h>
+
+VCDrawPacket::VCDrawPacket()
+{
+    model = nullptr;
+    program = 0;
+    vao = 0;
+    mode = GL_TRIANGLES;
+    count = 0;
+    indexType = GL_UNSIGNED_INT;
+    baseVertex = 0;
+    firstIndex = 0;
+    indirect = false;
+    firstInstance = 0;
+    instanceCount = 0;
+    patchVertices = 0;
+    tessLevel = 0.f;
+    std::fill(textures, textures + VC_MAX_TEXTURE_UNITS, 0);
+    std::fill(texTargets, texTargets + VC_MAX_TEXTURE_UNITS, GL_TEXTURE_2D);
+    mtlUBO = 0;
+    mtlOffset = 0;
+    mtlSize = 0;
+    mtlSlot = 0;
+    blend = VC_BLEND_OPAQUE;
+    depthWrite = GL_TRUE;
+    viewDepth = 0.f;
+    leapPos = glm::vec4(0.f);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+void
+VCRenderQueue::submit(const VCDrawPacket &_packet)
+{
+    m_order.push_back(std::make_pair(sortKey(_packet), m_packets.size()));
+    m_packets.push_back(_packet);
+}
+
+void
+VCRenderQueue::submit(const VCDrawPacket &_packet, const GLuint *_transforms, GLuint _numTransforms)
+{
+    assert(_packet.indirect);
+    submit(_packet);
+    m_packets.back().firstInstance = GLuint(m_instanceTransforms.size());
+    m_packets.back().instanceCount = _numTransforms;
+    m_instanceTransforms.insert(m_instanceTransforms.end(), _transforms, _transforms + _numTransforms);
+}
+
+uint64_t
+VCRenderQueue::sortKey(const VCDrawPacket &_packet)
+{
+    // the bits of a non negative float sort like the float
+    GLfloat depth = std::max(_packet.viewDepth, 0.f);
+    uint32_t depthBits;
+    memcpy(&depthBits, &depth, sizeof(depthBits));
+
+    uint64_t program = _packet.program & 0x3ff;
+    uint64_t texture = _packet.textures[0] & 0xfff;
+    uint64_t vao = _packet.vao & 0xfff;
+    if (_packet.blend == VC_BLEND_OPAQUE) {
+        return program << 53 | texture << 41 | vao << 29 | uint64_t(_packet.mtlSlot & 0xff) << 21 |
+            depthBits >> 11;
+    }
+    return uint64_t(1) << 63 | uint64_t(~depthBits >> 8 & 0xffffff) << 39 |
+        program << 29 | texture << 17 | vao << 5 | (_packet.mtlSlot & 0x1f);
+}
+
+bool
+VCRenderQueue::sameIndirectBatch(const VCDrawPacket &_first, const VCDrawPacket &_next)
+{
+    // the per object data of indirect packets is in VCDrawData, the model may change
+    if (!_next.indirect || _next.program != _first.program ||
+        _next.vao != _first.vao || _next.mode != _first.mode || _next.blend != _first.blend ||
+        _next.depthWrite != _first.depthWrite || _next.patchVertices != _first.patchVertices ||
+        _next.tessLevel != _first.tessLevel) {
+        return false;
+    }
+    if (_next.mtlUBO && (_next.mtlUBO != _first.mtlUBO || _next.mtlOffset != _first.mtlOffset)) {
+        return false;
+    }
+    for (int unit = 0; unit < VC_MAX_TEXTURE_UNITS; ++unit) {
+        if (_next.textures[unit] && _next.textures[unit] != _first.textures[unit]) return false;
+    }
+    return true;
+}
+
+void
+VCRenderQueue::uploadIndirect()
+{
+    m_commands.clear();
+    m_drawData.clear();
+    for (auto &entry : m_order) {
+        const VCDrawPacket &p = m_packets[entry.second];
+        if (!p.indirect) continue;
+        GLuint numInstances = std::max(p.instanceCount, 1u);
+        DrawElementsIndirectCommand cmd = { GLuint(p.count), numInstances, p.firstIndex, p.baseVertex,
+            GLuint(m_drawData.size()) };
+        m_commands.push_back(cmd);
+        for (GLuint i = 0; i < numInstances; ++i) {
+            GLuint slot = p.instanceCount ? m_instanceTransforms[p.firstInstance + i] : p.model->transformSlot();
+            VCDrawData data;
+            data.modelMat = ENV_VAR.transforms.modelMat(slot);
+            const glm::mat3 &nm = ENV_VAR.transforms.normalMat(slot);
+            for (int c = 0; c < 3; ++c) data.normalMat[c] = glm::vec4(nm[c], 0.f);
+            data.leapPos = p.leapPos;
+            m_drawData.push_back(data);
+        }
+    }
+    if (m_commands.empty()) return;
+
+    if (!m_indirectBO) {
+        glGenBuffers(1, &m_indirectBO);
+        glGenBuffers(1, &m_drawDataBO);
+        glGenBuffers(1, &m_drawIdBO);
+    }
+    // orphaned every flush, the driver can keep the buffers of the previous eye in flight
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirectBO);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, m_commands.size() * sizeof(DrawElementsIndirectCommand),
+        m_commands.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_drawDataBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, m_drawData.size() * sizeof(VCDrawData), m_drawData.data(), GL_STREAM_DRAW);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VC_DRAW_DATA_BINDING, m_drawDataBO);
+    if (m_numDrawIds < m_drawData.size()) {
+        m_numDrawIds = std::max(m_drawData.size(), m_numDrawIds * 2);
+        std::vector<GLuint> ids(m_numDrawIds);
+        for (size_t i = 0; i < ids.size(); ++i) ids[i] = GLuint(i);
+        glBindBuffer(GL_ARRAY_BUFFER, m_drawIdBO);
+        glBufferData(GL_ARRAY_BUFFER, ids.size() * sizeof(GLuint), ids.data(), GL_STATIC_DRAW);
+    }
+}
+
+void
+VCRenderQueue::flush()
+{
+    // equal keys keep the submission order
+    std::sort(m_order.begin(), m_order.end());
+    uploadIndirect();
+    GLuint nextCommand = 0;
+
+    // state is unknown at the beginning of a flush, the first packet sets everything
+    const VCDrawPacket *prev = nullptr;
+    GLuint boundTextures[VC_MAX_TEXTURE_UNITS] = {};
+    GLint activeUnit = -1;
+    GLuint boundMtlUBO = 0;
+    GLintptr boundMtlOffset = 0;
+    GLint boundPatchVertices = 0;
+    GLfloat boundTessLevel = 0.f;
+    glEnable(GL_DEPTH_TEST);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    for (size_t i = 0; i < m_order.size(); ++i) {
+        const VCDrawPacket &p = m_packets[m_order[i].second];
+        if (!prev || p.program != prev->program) {
+            glUseProgram(p.program);
+        }
+        if (!prev || p.program != prev->program || p.model != prev->model) {
+            p.model->setupObjectUniforms();
+        }
+        if (!prev || p.vao != prev->vao) {
+            glBindVertexArray(p.vao);
+        }
+        if (!prev || p.blend != prev->blend) {
+            if (p.blend == VC_BLEND_OPAQUE) glDisable(GL_BLEND);
+            else glEnable(GL_BLEND);
+        }
+        if (!prev || p.depthWrite != prev->depthWrite) {
+            glDepthMask(p.depthWrite);
+        }
+        if (p.mtlUBO && (p.mtlUBO != boundMtlUBO || p.mtlOffset != boundMtlOffset)) {
+            glBindBufferRange(GL_UNIFORM_BUFFER, VC_MATERIAL_BINDING, p.mtlUBO, p.mtlOffset, p.mtlSize);
+            boundMtlUBO = p.mtlUBO;
+            boundMtlOffset = p.mtlOffset;
+        }
+        for (int unit = 0; unit < VC_MAX_TEXTURE_UNITS; ++unit) {
+            if (!p.textures[unit] || p.textures[unit] == boundTextures[unit]) continue;
+            if (activeUnit != unit) {
+                glActiveTexture(GL_TEXTURE0 + unit);
+                activeUnit = unit;
+            }
+            glBindTexture(p.texTargets[unit], p.textures[unit]);
+            boundTextures[unit] = p.textures[unit];
+        }
+        if (p.patchVertices > 0 && (p.patchVertices != boundPatchVertices || p.tessLevel != boundTessLevel)) {
+            GLfloat outerLevel[4] = { p.tessLevel, p.tessLevel, p.tessLevel, p.tessLevel };
+            GLfloat innerLevel[2] = { p.tessLevel, p.tessLevel };
+            glPatchParameterfv(GL_PATCH_DEFAULT_OUTER_LEVEL, outerLevel);
+            glPatchParameterfv(GL_PATCH_DEFAULT_INNER_LEVEL, innerLevel);
+            glPatchParameteri(GL_PATCH_VERTICES, p.patchVertices);
+            boundPatchVertices = p.patchVertices;
+            boundTessLevel = p.tessLevel;
+        }
+
+        if (p.indirect) {
+            size_t end = i + 1;
+            while (end < m_order.size() && sameIndirectBatch(p, m_packets[m_order[end].second])) ++end;
+            glBindVertexBuffer(VC_ARENA_DRAW_ID_BINDING, m_drawIdBO, 0, sizeof(GLuint));
+            glMultiDrawElementsIndirect(p.mode, GL_UNSIGNED_INT,
+                (void *)(nextCommand * sizeof(DrawElementsIndirectCommand)), GLsizei(end - i), 0);
+            for (size_t k = i; k < end; ++k) {
+                ENV_VAR.cullStats.drawn += std::max(m_packets[m_order[k].second].instanceCount, 1u);
+            }
+            nextCommand += GLuint(end - i);
+            i = end - 1;
+            prev = &m_packets[m_order[i].second];
+            continue;
+        }
+
+        ++ENV_VAR.cullStats.drawn;
+        glDrawElements(p.mode, p.count, p.indexType, 0);
+        prev = &p;
+    }
+    assert(glGetError() == GL_NONE);
+
+    m_packets.clear();
+    m_order.clear();
+    m_instanceTransforms.clear();
+}
+
+void
+VCRenderQueue::release()
+{
+    SAFE_RELEASE_GL_BUFFER(m_indirectBO);
+    SAFE_RELEASE_GL_BUFFER(m_drawDataBO);
+    SAFE_RELEASE_GL_BUFFER(m_drawIdBO);
+    m_numDrawIds = 0;
+}
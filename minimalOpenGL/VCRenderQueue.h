@@ -0,0 +1,115 @@
+/*
+*  Render queue, models submit one draw packet per draw call instead of drawing.
+*
+*  flush() sorts the packets by a 64 bit key and issues them, changing only the
+*  GL state that differs from the previous packet. Packets with VC_BLEND_ALPHA
+*  are drawn after all opaque packets, back to front.
+*
+*  Key layout (most significant bit first):
+*    opaque      0 | program 10 | texture 12 | VAO 12 | material 8 | depth 21, front to back
+*    blended     1 | depth 24, back to front | program 10 | texture 12 | VAO 12 | material 5
+*  GL names are masked to their field, collisions only cost sorting quality.
+*
+*  Packets of groups in a VCStaticArena (indirect) share the VAO of the arena, so
+*  they end up next to each other when program and texture match. Each run of
+*  such packets that needs no state change in between is drawn with one
+*  glMultiDrawElementsIndirect, also across models. The commands and the per
+*  object data (model matrices, leapPos) of all indirect packets of a flush are
+*  uploaded once, the vertex shader finds its entry in the DrawData storage
+*  block through the draw id attribute.
+*
+*  An indirect packet can carry several transforms (instances of one model), it
+*  becomes one command with that many instances and consecutive DrawData entries.
+*/
+
+#pragma once
+#include "GL/glew.h"
+#include <glm.hpp>
+#include <stdint.h>
+#include <vector>
+
+class VCModel;
+
+enum VCBlendMode {
+    VC_BLEND_OPAQUE,
+    VC_BLEND_ALPHA, // GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA
+};
+
+// texture units a packet can bind, see VCWVObjModel::setupMtlPacket()
+const int VC_MAX_TEXTURE_UNITS = 4;
+
+struct VCDrawPacket {
+    const VCModel *model; // sets its per object uniforms when the model changes
+    GLuint program;
+    GLuint vao; // with the element buffer bound
+    GLenum mode;
+    GLsizei count;
+    GLenum indexType;
+    GLint baseVertex; // range in the arena buffers for indirect packets
+    GLuint firstIndex;
+    bool indirect; // drawn with glMultiDrawElementsIndirect, requires GL_UNSIGNED_INT indices
+    GLuint firstInstance; // transform slots of the instances in the queue, set by submit()
+    GLuint instanceCount; // 0 draws the model once with its own transform
+    GLint patchVertices; // for GL_PATCHES, also sets the default tessellation levels
+    GLfloat tessLevel;
+    GLuint textures[VC_MAX_TEXTURE_UNITS]; // 0 keeps what is bound to the unit
+    GLenum texTargets[VC_MAX_TEXTURE_UNITS];
+    GLuint mtlUBO; // range bound to VC_MATERIAL_BINDING, 0 if the shaders have no Material block
+    GLintptr mtlOffset;
+    GLsizeiptr mtlSize;
+    GLuint mtlSlot;
+    VCBlendMode blend;
+    GLboolean depthWrite;
+    GLfloat viewDepth; // distance of the bounds from the camera
+    glm::vec4 leapPos; // of the model, goes into VCDrawData for indirect packets
+
+    VCDrawPacket();
+};
+
+// std430 layout of one entry of the DrawData storage block in shaders/ps_model_indirect.vert
+struct VCDrawData {
+    glm::mat4 modelMat;
+    glm::vec4 normalMat[3]; // mat3 columns, padded to vec4
+    glm::vec4 leapPos;
+};
+static_assert(sizeof(VCDrawData) == 128, "VCDrawData must match the std430 layout");
+
+// binding point of the DrawData shader storage block
+const GLuint VC_DRAW_DATA_BINDING = 2;
+
+class VCRenderQueue {
+public:
+    void submit(const VCDrawPacket &_packet);
+    // indirect packet drawn once per transform slot (in ENV_VAR.transforms)
+    void submit(const VCDrawPacket &_packet, const GLuint *_transforms, GLuint _numTransforms);
+    // sorts and draws the packets of the current view and empties the queue
+    void flush();
+    // deletes the buffers of the indirect draws, call before the GL context goes away
+    void release();
+
+private:
+    // layout of the commands in GL_DRAW_INDIRECT_BUFFER
+    struct DrawElementsIndirectCommand {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance; // index into the draw data, read back through the draw id attribute
+    };
+
+    static uint64_t sortKey(const VCDrawPacket &_packet);
+    // true if _next can be drawn in the same multi draw as _first
+    static bool sameIndirectBatch(const VCDrawPacket &_first, const VCDrawPacket &_next);
+    // fills and uploads the commands and draw data of all indirect packets in sorted order
+    void uploadIndirect();
+
+    std::vector<VCDrawPacket> m_packets;
+    std::vector<std::pair<uint64_t, size_t>> m_order; // key, index into m_packets
+    std::vector<GLuint> m_instanceTransforms; // of all instanced packets
+    std::vector<DrawElementsIndirectCommand> m_commands;
+    std::vector<VCDrawData> m_drawData;
+    GLuint m_indirectBO = 0;
+    GLuint m_drawDataBO = 0;
+    GLuint m_drawIdBO = 0; // 0, 1, 2, ... for the draw id attribute
+    size_t m_numDrawIds = 0;
+};
@@ -0,0 +1,53 @@
+#include "VCResourceCache.h"
+#include "VCModels.h"
+#include <algorithm>
+#include <ctype.h>
+#include <stdlib.h>
+#include <vector>
+
+#ifndef _WIN32
+#include <limits.h>
+#endif
+
+VCResourceCache VC_RESOURCES;
+
+std::string
+vcCanonicalPath(const std::string &path)
+{
+#ifdef _WIN32
+    char buf[_MAX_PATH];
+    if (!_fullpath(buf, path.c_str(), _MAX_PATH)) return path;
+    std::string canonical(buf);
+    std::replace(canonical.begin(), canonical.end(), '/', '\\');
+    std::transform(canonical.begin(), canonical.end(), canonical.begin(), [](char c) { return char(tolower(c)); });
+    return canonical;
+#else
+    char buf[PATH_MAX];
+    if (!realpath(path.c_str(), buf)) return path;
+    return std::string(buf);
+#endif
+}
+
+std::string
+vcProgramKey(const std::map<std::string, GLenum> &_shaderPaths)
+{
+    // sorted, so different spellings of the same files give the same key
+    std::vector<std::string> shaders;
+    for (auto &shader : _shaderPaths) {
+        shaders.push_back(vcCanonicalPath(shader.first) + "|" + std::to_string(shader.second) + ";");
+    }
+    std::sort(shaders.begin(), shaders.end());
+    std::string key;
+    for (auto &shader : shaders) key += shader;
+    return key;
+}
+
+void
+VCResourceCache::printStats() const
+{
+    std::cout << "shared resources" << std::endl;
+    meshes.printStats("meshes");
+    textures.printStats("textures");
+    std::cout << "  texture files decoded: " << OGLTexture::numDecoded << std::endl;
+    programs.printStats("programs");
+}
@@ -0,0 +1,98 @@
+/*
+*  Shared, reference counted resources of the models.
+*
+*  Meshes, textures and shader programs are looked up by a key built from
+*  the canonical path of their files (plus the VC_* options for meshes and the
+*  shader types for programs). The pools only hold weak references, a resource
+*  is released when the last model using it goes away and loaded again by the
+*  next model asking for it.
+*/
+
+#pragma once
+#include "GL/glew.h"
+#include "helper/OGLTexture.h"
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+// absolute path with "." and ".." resolved, lower case on Windows, the path itself if it doesn't exist
+std::string vcCanonicalPath(const std::string &path);
+
+template <class T>
+class VCResourcePool {
+public:
+    // the live resource of _key, or the one _create() returns on a miss. _create returns a
+    // std::shared_ptr<T>, nullptr (failed to load) is returned without being cached.
+    // _bytes(resource) is the memory it occupies, asked for when the totals are printed
+    // since textures loaded asynchronously only get their size later
+    template <class Create, class Bytes>
+    std::shared_ptr<T> acquire(const std::string &_key, Create _create, Bytes _bytes)
+    {
+        auto found = m_entries.find(_key);
+        if (found != m_entries.end()) {
+            std::shared_ptr<T> resource = found->second.resource.lock();
+            if (resource) {
+                ++m_hits;
+                return resource;
+            }
+        }
+        ++m_misses;
+        std::shared_ptr<T> resource = _create();
+        if (!resource) return resource;
+        Entry &entry = m_entries[_key];
+        entry.resource = resource;
+        entry.bytes = _bytes;
+        return resource;
+    }
+
+    // "<_name>: <live> live (<bytes> bytes), <hits> hits, <misses> misses"
+    void printStats(const char *_name) const
+    {
+        size_t live = 0, bytes = 0;
+        for (auto &entry : m_entries) {
+            std::shared_ptr<T> resource = entry.second.resource.lock();
+            if (!resource) continue;
+            ++live;
+            bytes += entry.second.bytes(*resource);
+        }
+        std::cout << "  " << _name << ": " << live << " live (" << bytes << " bytes), "
+            << m_hits << " hits, " << m_misses << " misses" << std::endl;
+    }
+
+private:
+    struct Entry {
+        std::weak_ptr<T> resource;
+        std::function<size_t(T &)> bytes;
+    };
+    std::unordered_map<std::string, Entry> m_entries;
+    size_t m_hits = 0;
+    size_t m_misses = 0;
+};
+
+// linked shader program, deleted with the last reference
+struct VCProgram {
+    GLuint id;
+    explicit VCProgram(GLuint _id) : id(_id) {}
+    ~VCProgram() { glDeleteProgram(id); }
+    VCProgram(const VCProgram &) = delete;
+    VCProgram& operator=(const VCProgram &) = delete;
+};
+
+class VCWVObjMesh;
+
+struct VCResourceCache {
+    VCResourcePool<VCWVObjMesh> meshes;
+    VCResourcePool<OGLTexture> textures;
+    VCResourcePool<VCProgram> programs;
+
+    // hit/miss counts and memory of the live resources
+    void printStats() const;
+};
+
+extern VCResourceCache VC_RESOURCES;
+
+// key of the program linked from _shaderPaths (path -> shader type)
+std::string vcProgramKey(const std::map<std::string, GLenum> &_shaderPaths);
@@ -0,0 +1,107 @@
+#include "VCStaticArena.h"
+#include <algorithm>
+#include <map>
+#include <memory>
+
+namespace {
+
+std::map<GLuint, std::unique_ptr<VCStaticArena>> arenas; // layout -> arena
+
+} // namespace
+
+VCStaticArena&
+VCStaticArena::get(GLuint _layout, const std::vector<VCVertexAttrib> &_attribs, GLuint _stride)
+{
+    std::unique_ptr<VCStaticArena> &arena = arenas[_layout];
+    if (!arena) arena.reset(new VCStaticArena(_attribs, _stride));
+    return *arena;
+}
+
+void
+VCStaticArena::releaseAll()
+{
+    arenas.clear();
+}
+
+VCStaticArena::VCStaticArena(const std::vector<VCVertexAttrib> &_attribs, GLuint _stride)
+{
+    m_vertexBO = 0;
+    m_indexBO = 0;
+    m_stride = _stride;
+    m_vertexCapacity = 0;
+    m_indexCapacity = 0;
+    m_numVert = 0;
+    m_numIndices = 0;
+
+    // separate attribute formats, so growing the vertex buffer only rebinds the binding point
+    glGenVertexArrays(1, &m_vao);
+    glBindVertexArray(m_vao);
+    for (GLuint loc = 0; loc < _attribs.size(); ++loc) {
+        const VCVertexAttrib &a = _attribs[loc];
+        glVertexAttribFormat(loc, a.size, a.type, a.normalized, a.offset);
+        glVertexAttribBinding(loc, VC_ARENA_VERTEX_BINDING);
+        glEnableVertexAttribArray(loc);
+    }
+    glVertexAttribIFormat(VC_DRAW_ID_LOCATION, 1, GL_UNSIGNED_INT, 0);
+    glVertexAttribBinding(VC_DRAW_ID_LOCATION, VC_ARENA_DRAW_ID_BINDING);
+    glVertexBindingDivisor(VC_ARENA_DRAW_ID_BINDING, 1);
+    glEnableVertexAttribArray(VC_DRAW_ID_LOCATION);
+    glBindVertexArray(0);
+}
+
+VCStaticArena::~VCStaticArena()
+{
+    glDeleteBuffers(1, &m_vertexBO);
+    glDeleteBuffers(1, &m_indexBO);
+    glDeleteVertexArrays(1, &m_vao);
+}
+
+void
+VCStaticArena::add(const GLubyte *_vertices, GLuint _numVert, const GLuint *_indices, GLuint _numIndices,
+    GLint &_baseVertex, GLuint &_firstIndex)
+{
+    GLsizeiptr vertexBytes = (GLsizeiptr)_numVert * m_stride;
+    GLsizeiptr indexBytes = (GLsizeiptr)_numIndices * sizeof(GLuint);
+    GLsizeiptr vertexUsed = (GLsizeiptr)m_numVert * m_stride;
+    GLsizeiptr indexUsed = (GLsizeiptr)m_numIndices * sizeof(GLuint);
+
+    glBindVertexArray(m_vao);
+    reserve(GL_ARRAY_BUFFER, &m_vertexBO, m_vertexCapacity, vertexUsed, vertexBytes);
+    reserve(GL_ELEMENT_ARRAY_BUFFER, &m_indexBO, m_indexCapacity, indexUsed, indexBytes);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vertexBO);
+    glBufferSubData(GL_ARRAY_BUFFER, vertexUsed, vertexBytes, _vertices);
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, indexUsed, indexBytes, _indices);
+    glBindVertexArray(0);
+
+    _baseVertex = GLint(m_numVert);
+    _firstIndex = m_numIndices;
+    m_numVert += _numVert;
+    m_numIndices += _numIndices;
+}
+
+void
+VCStaticArena::reserve(GLenum _target, GLuint *_buffer, GLsizeiptr &_capacity, GLsizeiptr _used, GLsizeiptr _needed)
+{
+    if (_used + _needed <= _capacity) return;
+
+    GLsizeiptr capacity = std::max(_capacity * 2, _used + _needed);
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, capacity, nullptr, GL_STATIC_DRAW);
+    if (_used > 0) {
+        glBindBuffer(GL_COPY_READ_BUFFER, *_buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, _used);
+    }
+    glDeleteBuffers(1, _buffer);
+    *_buffer = buffer;
+    _capacity = capacity;
+
+    // the VAO of the arena is bound by add()
+    if (_target == GL_ELEMENT_ARRAY_BUFFER) {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+    }
+    else {
+        glBindVertexBuffer(VC_ARENA_VERTEX_BINDING, buffer, 0, m_stride);
+    }
+}
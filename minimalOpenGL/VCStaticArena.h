@@ -0,0 +1,64 @@
+/*
+*  Shared vertex and index buffers for static geometry (VC_STATIC_ARENA in VCModels.h).
+*
+*  There is one arena per interleaved vertex layout. Material groups append their
+*  vertices and 32 bit indices and keep the base vertex and first index of their
+*  range, so all groups of a layout share one VAO and can be drawn together with
+*  glMultiDrawElementsIndirect (see VCRenderQueue::flush()).
+*
+*  The buffers double their size when they are full. Ranges are never freed, the
+*  arena is meant for meshes loaded at startup and lives until releaseAll().
+*/
+
+#pragma once
+#include "GL/glew.h"
+#include <vector>
+
+// one attribute of an interleaved vertex, the attribute location is its index
+struct VCVertexAttrib {
+    GLint size;
+    GLenum type;
+    GLboolean normalized;
+    GLuint offset; // bytes from the start of the vertex
+};
+
+// attribute location of the draw index, an integer attribute with divisor 1 read from
+// VCRenderQueue's draw id buffer. the base instance of each indirect command selects the entry,
+// which works without ARB_shader_draw_parameters (gl_DrawID is GLSL 4.60)
+const GLuint VC_DRAW_ID_LOCATION = 7;
+// vertex buffer binding indices of the arena VAO
+const GLuint VC_ARENA_VERTEX_BINDING = 0;
+const GLuint VC_ARENA_DRAW_ID_BINDING = 1;
+
+class VCStaticArena {
+public:
+    // arena of the layout key (the VC_* vertex layout bits), created with the given
+    // attributes and vertex size on first use
+    static VCStaticArena& get(GLuint _layout, const std::vector<VCVertexAttrib> &_attribs, GLuint _stride);
+    // deletes the buffers and VAOs of all arenas, call before the GL context goes away
+    static void releaseAll();
+
+    // appends _numVert vertices of the arena's stride and _numIndices indices relative to them
+    void add(const GLubyte *_vertices, GLuint _numVert, const GLuint *_indices, GLuint _numIndices,
+        GLint &_baseVertex, GLuint &_firstIndex);
+    GLuint vao() const { return m_vao; }
+
+    ~VCStaticArena();
+
+private:
+    VCStaticArena(const std::vector<VCVertexAttrib> &_attribs, GLuint _stride);
+    VCStaticArena(const VCStaticArena &) = delete;
+    VCStaticArena& operator=(const VCStaticArena &) = delete;
+
+    // makes room for _needed bytes in *_buffer, copying the _used bytes of the old buffer
+    void reserve(GLenum _target, GLuint *_buffer, GLsizeiptr &_capacity, GLsizeiptr _used, GLsizeiptr _needed);
+
+    GLuint m_vao;
+    GLuint m_vertexBO;
+    GLuint m_indexBO;
+    GLuint m_stride;
+    GLsizeiptr m_vertexCapacity; // bytes
+    GLsizeiptr m_indexCapacity; // bytes
+    GLuint m_numVert;
+    GLuint m_numIndices;
+};
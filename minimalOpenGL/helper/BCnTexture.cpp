@@ -0,0 +1,230 @@
+#include "BCnTexture.h"
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+
+// the DDS_HEADER after the "DDS " magic, as dwords
+const int DDS_HEADER_DWORDS = 31;
+enum {
+    DDS_SIZE = 0, DDS_FLAGS = 1, DDS_HEIGHT = 2, DDS_WIDTH = 3, DDS_LINEAR_SIZE = 4,
+    DDS_MIPMAP_COUNT = 6, DDS_PF_SIZE = 18, DDS_PF_FLAGS = 19, DDS_PF_FOURCC = 20, DDS_CAPS = 26
+};
+const uint32_t DDSD_CAPS = 0x1, DDSD_HEIGHT = 0x2, DDSD_WIDTH = 0x4, DDSD_PIXELFORMAT = 0x1000;
+const uint32_t DDSD_MIPMAPCOUNT = 0x20000, DDSD_LINEARSIZE = 0x80000;
+const uint32_t DDPF_FOURCC = 0x4;
+const uint32_t DDSCAPS_COMPLEX = 0x8, DDSCAPS_TEXTURE = 0x1000, DDSCAPS_MIPMAP = 0x400000;
+
+uint32_t
+fourCC(const char *_code)
+{
+    return uint32_t(_code[0]) | uint32_t(_code[1]) << 8 | uint32_t(_code[2]) << 16 | uint32_t(_code[3]) << 24;
+}
+
+size_t
+blockBytes(VCBCnFormat _format)
+{
+    return _format == VC_BC1 ? 8 : 16;
+}
+
+int
+to565(const int *_rgb)
+{
+    return ((_rgb[0] * 31 + 127) / 255) << 11 | ((_rgb[1] * 63 + 127) / 255) << 5 | (_rgb[2] * 31 + 127) / 255;
+}
+
+void
+from565(int _c, int *_rgb)
+{
+    int r = _c >> 11, g = (_c >> 5) & 63, b = _c & 31;
+    _rgb[0] = r << 3 | r >> 2;
+    _rgb[1] = g << 2 | g >> 4;
+    _rgb[2] = b << 3 | b >> 2;
+}
+
+// the two pixels furthest apart along the principal axis of the block's colours are the
+// endpoints, every pixel takes the nearest of the four palette entries
+void
+encodeColorBlock(const unsigned char *_block, unsigned char *_out)
+{
+    float mean[3] = { 0.f, 0.f, 0.f };
+    for (int i = 0; i < 16; ++i) {
+        for (int k = 0; k < 3; ++k) mean[k] += _block[4 * i + k] / 16.f;
+    }
+    float cov[3][3] = {};
+    for (int i = 0; i < 16; ++i) {
+        float d[3] = { _block[4 * i] - mean[0], _block[4 * i + 1] - mean[1], _block[4 * i + 2] - mean[2] };
+        for (int j = 0; j < 3; ++j) {
+            for (int k = 0; k < 3; ++k) cov[j][k] += d[j] * d[k];
+        }
+    }
+    float axis[3] = { 1.f, 1.f, 1.f };
+    for (int iter = 0; iter < 8; ++iter) {
+        float next[3];
+        for (int j = 0; j < 3; ++j) next[j] = cov[j][0] * axis[0] + cov[j][1] * axis[1] + cov[j][2] * axis[2];
+        float len = sqrtf(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+        if (len < 1e-6f) break;
+        for (int j = 0; j < 3; ++j) axis[j] = next[j] / len;
+    }
+    int minPixel = 0, maxPixel = 0;
+    float minT = 1e30f, maxT = -1e30f;
+    for (int i = 0; i < 16; ++i) {
+        float t = _block[4 * i] * axis[0] + _block[4 * i + 1] * axis[1] + _block[4 * i + 2] * axis[2];
+        if (t < minT) { minT = t; minPixel = i; }
+        if (t > maxT) { maxT = t; maxPixel = i; }
+    }
+
+    int rgb0[3], rgb1[3];
+    for (int k = 0; k < 3; ++k) {
+        rgb0[k] = _block[4 * maxPixel + k];
+        rgb1[k] = _block[4 * minPixel + k];
+    }
+    int c0 = to565(rgb0), c1 = to565(rgb1);
+    // c0 > c1 selects the four colour mode, BC3 always decodes that way
+    if (c0 < c1) std::swap(c0, c1);
+    uint32_t indices = 0;
+    if (c0 != c1) {
+        int palette[4][3];
+        from565(c0, palette[0]);
+        from565(c1, palette[1]);
+        for (int k = 0; k < 3; ++k) {
+            palette[2][k] = (2 * palette[0][k] + palette[1][k]) / 3;
+            palette[3][k] = (palette[0][k] + 2 * palette[1][k]) / 3;
+        }
+        for (int i = 0; i < 16; ++i) {
+            int best = 0, bestDist = 1 << 30;
+            for (int p = 0; p < 4; ++p) {
+                int dist = 0;
+                for (int k = 0; k < 3; ++k) {
+                    int d = _block[4 * i + k] - palette[p][k];
+                    dist += d * d;
+                }
+                if (dist < bestDist) { bestDist = dist; best = p; }
+            }
+            indices |= uint32_t(best) << (2 * i);
+        }
+    }
+    _out[0] = (unsigned char)(c0 & 0xff);
+    _out[1] = (unsigned char)(c0 >> 8);
+    _out[2] = (unsigned char)(c1 & 0xff);
+    _out[3] = (unsigned char)(c1 >> 8);
+    for (int i = 0; i < 4; ++i) _out[4 + i] = (unsigned char)(indices >> (8 * i));
+}
+
+// eight interpolated values between the block's min and max alpha
+void
+encodeAlphaBlock(const unsigned char *_block, unsigned char *_out)
+{
+    int a0 = 0, a1 = 255;
+    for (int i = 0; i < 16; ++i) {
+        a0 = std::max(a0, int(_block[4 * i + 3]));
+        a1 = std::min(a1, int(_block[4 * i + 3]));
+    }
+    uint64_t indices = 0;
+    if (a0 != a1) {
+        int values[8] = { a0, a1 };
+        for (int i = 1; i < 7; ++i) values[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+        for (int i = 0; i < 16; ++i) {
+            int best = 0, bestDist = 256;
+            for (int v = 0; v < 8; ++v) {
+                int dist = abs(_block[4 * i + 3] - values[v]);
+                if (dist < bestDist) { bestDist = dist; best = v; }
+            }
+            indices |= uint64_t(best) << (3 * i);
+        }
+    }
+    _out[0] = (unsigned char)a0;
+    _out[1] = (unsigned char)a1;
+    for (int i = 0; i < 6; ++i) _out[2 + i] = (unsigned char)(indices >> (8 * i));
+}
+
+} // namespace
+
+size_t
+vcBCnLevelSize(VCBCnFormat _format, int _width, int _height)
+{
+    return size_t((_width + 3) / 4) * size_t((_height + 3) / 4) * blockBytes(_format);
+}
+
+void
+vcEncodeBCn(VCBCnFormat _format, const unsigned char *_pixels, int _width, int _height,
+    unsigned char *_blocks, int _firstBlockRow, int _endBlockRow)
+{
+    int blocksX = (_width + 3) / 4, blocksY = (_height + 3) / 4;
+    if (_endBlockRow < 0 || _endBlockRow > blocksY) _endBlockRow = blocksY;
+    unsigned char block[64];
+    for (int by = _firstBlockRow; by < _endBlockRow; ++by) {
+        for (int bx = 0; bx < blocksX; ++bx) {
+            for (int y = 0; y < 4; ++y) {
+                const unsigned char *row = _pixels + size_t(std::min(by * 4 + y, _height - 1)) * _width * 4;
+                for (int x = 0; x < 4; ++x) {
+                    memcpy(block + 16 * y + 4 * x, row + 4 * std::min(bx * 4 + x, _width - 1), 4);
+                }
+            }
+            unsigned char *out = _blocks + (size_t(by) * blocksX + bx) * blockBytes(_format);
+            if (_format == VC_BC3) {
+                encodeAlphaBlock(block, out);
+                out += 8;
+            }
+            encodeColorBlock(block, out);
+        }
+    }
+}
+
+bool
+vcWriteDDS(const std::string &_path, VCBCnFormat _format, int _width, int _height,
+    const std::vector<std::vector<unsigned char>> &_levels)
+{
+    uint32_t header[DDS_HEADER_DWORDS] = {};
+    header[DDS_SIZE] = DDS_HEADER_DWORDS * 4;
+    header[DDS_FLAGS] = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+    header[DDS_HEIGHT] = (uint32_t)_height;
+    header[DDS_WIDTH] = (uint32_t)_width;
+    header[DDS_LINEAR_SIZE] = (uint32_t)vcBCnLevelSize(_format, _width, _height);
+    header[DDS_MIPMAP_COUNT] = (uint32_t)_levels.size();
+    header[DDS_PF_SIZE] = 32;
+    header[DDS_PF_FLAGS] = DDPF_FOURCC;
+    header[DDS_PF_FOURCC] = fourCC(_format == VC_BC1 ? "DXT1" : "DXT5");
+    header[DDS_CAPS] = DDSCAPS_TEXTURE | (_levels.size() > 1 ? DDSCAPS_COMPLEX | DDSCAPS_MIPMAP : 0);
+
+    FILE *file = fopen(_path.c_str(), "wb");
+    if (!file) return false;
+    bool ok = fwrite("DDS ", 4, 1, file) == 1 && fwrite(header, sizeof(header), 1, file) == 1;
+    for (auto &level : _levels) {
+        ok = ok && fwrite(level.data(), level.size(), 1, file) == 1;
+    }
+    return fclose(file) == 0 && ok;
+}
+
+bool
+vcParseDDS(const char *_data, size_t _size, VCBCnFormat &_format, std::vector<VCBCnLevel> &_levels)
+{
+    uint32_t header[DDS_HEADER_DWORDS];
+    if (_size < 4 + sizeof(header) || memcmp(_data, "DDS ", 4) != 0) return false;
+    memcpy(header, _data + 4, sizeof(header));
+    if (header[DDS_SIZE] != sizeof(header) || !(header[DDS_PF_FLAGS] & DDPF_FOURCC)) return false;
+    if (header[DDS_PF_FOURCC] == fourCC("DXT1")) _format = VC_BC1;
+    else if (header[DDS_PF_FOURCC] == fourCC("DXT5")) _format = VC_BC3;
+    else return false;
+
+    int width = (int)header[DDS_WIDTH], height = (int)header[DDS_HEIGHT];
+    uint32_t numLevels = (header[DDS_FLAGS] & DDSD_MIPMAPCOUNT) ? std::max(1u, header[DDS_MIPMAP_COUNT]) : 1;
+    size_t offset = 4 + sizeof(header);
+    _levels.clear();
+    for (uint32_t i = 0; i < numLevels; ++i) {
+        VCBCnLevel level;
+        level.width = std::max(1, width >> i);
+        level.height = std::max(1, height >> i);
+        level.offset = offset;
+        level.size = vcBCnLevelSize(_format, level.width, level.height);
+        if (offset + level.size > _size) return false;
+        offset += level.size;
+        _levels.push_back(level);
+        if (level.width == 1 && level.height == 1) break;
+    }
+    return true;
+}
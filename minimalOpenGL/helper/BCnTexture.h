@@ -0,0 +1,40 @@
+/*
+*  Block compressed textures (BC1 = DXT1, BC3 = DXT5) in DDS files.
+*
+*  The texcompress tool encodes the .jpg/.png textures offline, OGLTexture::loadCompressed()
+*  uploads the blocks as they are with glCompressedTexImage2D. The rows are stored bottom
+*  row first, the order OGLTexture::load() uploads decoded images in, so other DDS viewers
+*  show these files upside down. No GL in here.
+*/
+
+#pragma once
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+enum VCBCnFormat {
+    VC_BC1, // RGB, 8 bytes per 4x4 block
+    VC_BC3  // RGBA, 16 bytes per 4x4 block
+};
+
+struct VCBCnLevel {
+    int width, height;
+    size_t offset; // from the start of the file
+    size_t size;
+};
+
+// bytes of a _width x _height level
+size_t vcBCnLevelSize(VCBCnFormat _format, int _width, int _height);
+
+// encodes the block rows [_firstBlockRow, _endBlockRow) of the RGBA8 image _pixels into _blocks,
+// which holds the whole level. Split the rows between threads for large images, -1 is up to the end.
+// Pixels past the right/bottom edge repeat the last column/row
+void vcEncodeBCn(VCBCnFormat _format, const unsigned char *_pixels, int _width, int _height,
+    unsigned char *_blocks, int _firstBlockRow = 0, int _endBlockRow = -1);
+
+// level 0 is _width x _height, level i max(1, _width >> i) x max(1, _height >> i)
+bool vcWriteDDS(const std::string &_path, VCBCnFormat _format, int _width, int _height,
+    const std::vector<std::vector<unsigned char>> &_levels);
+
+// the format and levels of the DDS file in _data, false if it isn't a BC1/BC3 file or is truncated
+bool vcParseDDS(const char *_data, size_t _size, VCBCnFormat &_format, std::vector<VCBCnLevel> &_levels);
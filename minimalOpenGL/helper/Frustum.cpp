@@ -0,0 +1,134 @@
+#include "Frustum.h"
+#include <algorithm>
+#include <math.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define VC_FRUSTUM_SSE
+#include <xmmintrin.h>
+#endif
+
+VCBounds::VCBounds(const GLfloat *positions, size_t numVert)
+{
+    valid = positions != nullptr && numVert > 0;
+    min = max = center = glm::vec3(0.f);
+    radius = 0.f;
+    if (!valid) return;
+
+    min = max = glm::vec3(positions[0], positions[1], positions[2]);
+    for (size_t i = 1; i < numVert; ++i) {
+        glm::vec3 p(positions[i * 3], positions[i * 3 + 1], positions[i * 3 + 2]);
+        min = glm::min(min, p);
+        max = glm::max(max, p);
+    }
+    // tighter than half the diagonal for round objects
+    center = (min + max) * 0.5f;
+    GLfloat radius2 = 0.f;
+    for (size_t i = 0; i < numVert; ++i) {
+        glm::vec3 d = glm::vec3(positions[i * 3], positions[i * 3 + 1], positions[i * 3 + 2]) - center;
+        radius2 = std::max(radius2, glm::dot(d, d));
+    }
+    radius = sqrtf(radius2);
+}
+
+void
+VCBounds::merge(const VCBounds &_other)
+{
+    if (!_other.valid) return;
+    if (!valid) {
+        *this = _other;
+        return;
+    }
+    glm::vec3 oldCenter = center;
+    GLfloat oldRadius = radius;
+    min = glm::min(min, _other.min);
+    max = glm::max(max, _other.max);
+    center = (min + max) * 0.5f;
+    radius = std::max(glm::length(oldCenter - center) + oldRadius,
+        glm::length(_other.center - center) + _other.radius);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+VCFrustum::VCFrustum()
+{
+    // everything is visible until the first setViewProj()
+    for (int c = 0; c < 7; ++c) {
+        std::fill(m_planes[c], m_planes[c] + 8, c == 3 ? 1e30f : 0.f);
+    }
+}
+
+void
+VCFrustum::setViewProj(const glm::mat4 &viewProj)
+{
+    glm::vec4 rows[4];
+    for (int r = 0; r < 4; ++r) {
+        rows[r] = glm::vec4(viewProj[0][r], viewProj[1][r], viewProj[2][r], viewProj[3][r]);
+    }
+    for (int i = 0; i < 6; ++i) {
+        glm::vec4 p = (i % 2 == 0) ? rows[3] + rows[i / 2] : rows[3] - rows[i / 2];
+        p /= glm::length(glm::vec3(p));
+        for (int c = 0; c < 4; ++c) m_planes[c][i] = p[c];
+        for (int c = 0; c < 3; ++c) m_planes[4 + c][i] = fabsf(p[c]);
+    }
+}
+
+bool
+VCFrustum::isVisible(const VCBounds &_bounds, const glm::mat4 &modelMat) const
+{
+    if (!_bounds.valid) return true;
+
+    // world space sphere, the radius grows with the largest scale
+    glm::vec3 center(modelMat * glm::vec4(_bounds.center, 1.f));
+    GLfloat scale2 = std::max(std::max(glm::dot(glm::vec3(modelMat[0]), glm::vec3(modelMat[0])),
+        glm::dot(glm::vec3(modelMat[1]), glm::vec3(modelMat[1]))),
+        glm::dot(glm::vec3(modelMat[2]), glm::vec3(modelMat[2])));
+    GLfloat radius = _bounds.radius * sqrtf(scale2);
+
+    // world space box enclosing the transformed box
+    glm::mat3 absRot(glm::abs(glm::vec3(modelMat[0])), glm::abs(glm::vec3(modelMat[1])),
+        glm::abs(glm::vec3(modelMat[2])));
+    glm::vec3 boxCenter(modelMat * glm::vec4((_bounds.min + _bounds.max) * 0.5f, 1.f));
+    glm::vec3 boxExtent = absRot * ((_bounds.max - _bounds.min) * 0.5f);
+
+#ifdef VC_FRUSTUM_SSE
+    __m128 r = _mm_set1_ps(radius);
+    __m128 cx = _mm_set1_ps(center.x), cy = _mm_set1_ps(center.y), cz = _mm_set1_ps(center.z);
+    __m128 bx = _mm_set1_ps(boxCenter.x), by = _mm_set1_ps(boxCenter.y), bz = _mm_set1_ps(boxCenter.z);
+    __m128 ex = _mm_set1_ps(boxExtent.x), ey = _mm_set1_ps(boxExtent.y), ez = _mm_set1_ps(boxExtent.z);
+    int straddling = 0;
+    for (int i = 0; i < 8; i += 4) {
+        __m128 nx = _mm_loadu_ps(&m_planes[0][i]), ny = _mm_loadu_ps(&m_planes[1][i]);
+        __m128 nz = _mm_loadu_ps(&m_planes[2][i]), d = _mm_loadu_ps(&m_planes[3][i]);
+        __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)),
+            _mm_add_ps(_mm_mul_ps(nz, cz), d));
+        if (_mm_movemask_ps(_mm_cmplt_ps(dist, _mm_sub_ps(_mm_setzero_ps(), r)))) return false;
+        straddling |= _mm_movemask_ps(_mm_cmplt_ps(dist, r));
+    }
+    if (!straddling) return true;
+
+    for (int i = 0; i < 8; i += 4) {
+        __m128 nx = _mm_loadu_ps(&m_planes[0][i]), ny = _mm_loadu_ps(&m_planes[1][i]);
+        __m128 nz = _mm_loadu_ps(&m_planes[2][i]), d = _mm_loadu_ps(&m_planes[3][i]);
+        __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, bx), _mm_mul_ps(ny, by)),
+            _mm_add_ps(_mm_mul_ps(nz, bz), d));
+        __m128 proj = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&m_planes[4][i]), ex),
+            _mm_mul_ps(_mm_loadu_ps(&m_planes[5][i]), ey)), _mm_mul_ps(_mm_loadu_ps(&m_planes[6][i]), ez));
+        if (_mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(dist, proj), _mm_setzero_ps()))) return false;
+    }
+    return true;
+#else
+    bool straddling = false;
+    for (int i = 0; i < 6; ++i) {
+        GLfloat dist = m_planes[0][i] * center.x + m_planes[1][i] * center.y + m_planes[2][i] * center.z + m_planes[3][i];
+        if (dist < -radius) return false;
+        straddling = straddling || dist < radius;
+    }
+    if (!straddling) return true;
+
+    for (int i = 0; i < 6; ++i) {
+        GLfloat dist = m_planes[0][i] * boxCenter.x + m_planes[1][i] * boxCenter.y + m_planes[2][i] * boxCenter.z + m_planes[3][i];
+        GLfloat proj = m_planes[4][i] * boxExtent.x + m_planes[5][i] * boxExtent.y + m_planes[6][i] * boxExtent.z;
+        if (dist + proj < 0.f) return false;
+    }
+    return true;
+#endif
+}
@@ -0,0 +1,47 @@
+/*
+*  Bounding volumes and view frustum culling.
+*
+*  VCBounds holds an axis aligned box and a sphere in object space. VCFrustum
+*  transforms them with the model matrix and tests them against the six planes
+*  of the view frustum, the sphere first and the box only if the sphere
+*  straddles a plane. The planes are kept as structure of arrays, so one SSE
+*  register tests four planes at once.
+*/
+
+#pragma once
+#include "GL/glew.h"
+#include <glm.hpp>
+
+struct VCBounds {
+    glm::vec3 min;
+    glm::vec3 max;
+    glm::vec3 center; // sphere center, center of the box
+    GLfloat radius;
+    bool valid; // false if there are no positions, never culled
+
+    VCBounds() : min(0.f), max(0.f), center(0.f), radius(0.f), valid(false) {}
+    // bounds of numVert positions, 3 floats each
+    VCBounds(const GLfloat *positions, size_t numVert);
+    // grows this to enclose _other
+    void merge(const VCBounds &_other);
+};
+
+// draws (instances of instanced draws) issued and skipped, summed over all views of a frame
+struct VCCullStats {
+    GLuint drawn;
+    GLuint culled;
+};
+
+class VCFrustum {
+public:
+    VCFrustum();
+    // extracts the planes from the clip space of viewProj (OpenGL, -w <= z <= w)
+    void setViewProj(const glm::mat4 &viewProj);
+    // true if _bounds transformed by modelMat may be inside the frustum
+    bool isVisible(const VCBounds &_bounds, const glm::mat4 &modelMat) const;
+
+private:
+    // planes 0-5: left, right, bottom, top, near, far, 6-7 pass everything.
+    // n.x, n.y, n.z, d, |n.x|, |n.y|, |n.z| of all planes, points with n.p + d >= 0 are inside
+    GLfloat m_planes[7][8];
+};
@@ -30,6 +30,39 @@ printVec3(glm::vec3 v, std::string vecName)
     std::cout << std::endl;
 }
 
+void
+initPerViewUniforms()
+{
+    glGenBuffers(1, &ENV_VAR.perViewUBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, ENV_VAR.perViewUBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(PerViewUniforms), NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, VC_PER_VIEW_BINDING, ENV_VAR.perViewUBO);
+}
+
+void
+updatePerViewUniforms()
+{
+    PerViewUniforms perView;
+    perView.projMat = ENV_VAR.projMat;
+    perView.viewMat = ENV_VAR.viewMat;
+    perView.viewProjMat = ENV_VAR.projMat * ENV_VAR.viewMat;
+    perView.camPos = ENV_VAR.camPos;
+    perView.pad0 = 0.f;
+    perView.lightPos = ENV_VAR.lightPos;
+    perView.pad1 = 0.f;
+    glBindBuffer(GL_UNIFORM_BUFFER, ENV_VAR.perViewUBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(PerViewUniforms), &perView);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    ENV_VAR.frustum.setViewProj(perView.viewProjMat);
+}
+
+void
+releasePerViewUniforms()
+{
+    SAFE_RELEASE_GL_BUFFER(ENV_VAR.perViewUBO);
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 //OpenGL utility functions
 
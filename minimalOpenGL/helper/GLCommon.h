@@ -6,21 +6,54 @@
 #include <glm.hpp>
 #include <string>
 #include <vector>
+#include "Frustum.h"
 #include "OGLTexture.h"
+#include "TransformStore.h"
 
 class VCModel;
 
+// std140 layout of the PerView uniform block declared in the shaders
+struct PerViewUniforms {
+    glm::mat4 projMat;
+    glm::mat4 viewMat;
+    glm::mat4 viewProjMat;
+    glm::vec3 camPos;
+    float pad0;
+    glm::vec3 lightPos;
+    float pad1;
+};
+static_assert(sizeof(PerViewUniforms) == 224, "PerViewUniforms must match the std140 layout");
+
+// binding point of the PerView uniform block
+const GLuint VC_PER_VIEW_BINDING = 0;
+
 struct EnvVar {
     glm::vec3 camPos;
+    glm::vec3 lightPos;
     OGLTexture envMap;
     glm::mat4 viewMat;
     glm::mat4 projMat;
     std::vector<VCModel *> scene;
+    // transforms of all models in scene
+    VCTransformStore transforms;
     bool FULL_BODY_ON;
+    bool FRUSTUM_CULLING_ON;
+    // frustum of the current eye, set by updatePerViewUniforms()
+    VCFrustum frustum;
+    // reset once per frame
+    VCCullStats cullStats;
+    GLuint perViewUBO;
 };
 
 extern EnvVar ENV_VAR;
 
+// creates ENV_VAR.perViewUBO and binds it to VC_PER_VIEW_BINDING
+void initPerViewUniforms();
+// uploads projMat, viewMat, camPos and lightPos of ENV_VAR and updates ENV_VAR.frustum,
+// call once per eye before drawing
+void updatePerViewUniforms();
+void releasePerViewUniforms();
+
 void printMat4(glm::mat4 m, std::string matName = "");
 void printVec3(glm::vec3 v, std::string vecName = "");
 
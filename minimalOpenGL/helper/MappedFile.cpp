@@ -0,0 +1,95 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() :
+    m_data(nullptr), m_size(0), m_open(false)
+#ifdef _WIN32
+    , m_file(INVALID_HANDLE_VALUE), m_mapping(nullptr)
+#else
+    , m_fd(-1)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool
+MappedFile::open(const char *path)
+{
+    close();
+#ifdef _WIN32
+    m_file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (m_file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(m_file, &fileSize)) {
+        close();
+        return false;
+    }
+    m_size = (size_t)fileSize.QuadPart;
+    if (m_size > 0) {
+        m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (!m_mapping) {
+            close();
+            return false;
+        }
+        m_data = (const char *)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!m_data) {
+            close();
+            return false;
+        }
+    }
+#else
+    m_fd = ::open(path, O_RDONLY);
+    if (m_fd < 0) return false;
+
+    struct stat st;
+    if (fstat(m_fd, &st) != 0) {
+        close();
+        return false;
+    }
+    m_size = (size_t)st.st_size;
+    if (m_size > 0) {
+        void *addr = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+        if (addr == MAP_FAILED) {
+            close();
+            return false;
+        }
+        madvise(addr, m_size, MADV_SEQUENTIAL);
+        m_data = (const char *)addr;
+    }
+#endif
+    m_open = true;
+    return true;
+}
+
+void
+MappedFile::close()
+{
+#ifdef _WIN32
+    if (m_data) UnmapViewOfFile(m_data);
+    if (m_mapping) CloseHandle(m_mapping);
+    if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+    m_mapping = nullptr;
+    m_file = INVALID_HANDLE_VALUE;
+#else
+    if (m_data) munmap((void *)m_data, m_size);
+    if (m_fd >= 0) ::close(m_fd);
+    m_fd = -1;
+#endif
+    m_data = nullptr;
+    m_size = 0;
+    m_open = false;
+}
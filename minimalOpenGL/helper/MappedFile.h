@@ -0,0 +1,37 @@
+/*
+*  MappedFile maps a whole file read-only into the address space
+*  (MapViewOfFile on Windows, mmap everywhere else), so that parsers
+*  can walk the bytes directly instead of going through FILE* buffering.
+*/
+
+#pragma once
+#include <stddef.h>
+
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    // returns false if the file can't be opened or mapped,
+    // an empty file is opened successfully with data() == nullptr
+    bool open(const char *path);
+    void close();
+
+    const char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+    bool isOpen() const { return m_open; }
+
+private:
+    MappedFile(const MappedFile &);
+    MappedFile& operator=(const MappedFile &);
+
+    const char *m_data;
+    size_t m_size;
+    bool m_open;
+#ifdef _WIN32
+    void *m_file;
+    void *m_mapping;
+#else
+    int m_fd;
+#endif
+};
@@ -0,0 +1,236 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <math.h>
+
+size_t
+vcSimulateVertexCache(const GLuint *indices, size_t numIndices, GLuint numVert, GLuint cacheSize)
+{
+    // FIFO cache: a vertex is in the cache as long as less than cacheSize misses happened since it was loaded
+    std::vector<size_t> loadTime(numVert, 0);
+    size_t time = cacheSize + 1;
+    size_t misses = 0;
+    for (size_t i = 0; i < numIndices; ++i) {
+        GLuint v = indices[i];
+        if (time - loadTime[v] > cacheSize) {
+            loadTime[v] = time++;
+            ++misses;
+        }
+    }
+    return misses;
+}
+
+namespace {
+
+// vertex -> triangle adjacency in compressed row form
+struct TriangleAdjacency {
+    std::vector<GLuint> offsets; // numVert + 1
+    std::vector<GLuint> triangles;
+
+    TriangleAdjacency(const GLuint *indices, size_t numIndices, GLuint numVert) :
+        offsets(numVert + 1, 0), triangles(numIndices)
+    {
+        for (size_t i = 0; i < numIndices; ++i) ++offsets[indices[i] + 1];
+        for (GLuint v = 0; v < numVert; ++v) offsets[v + 1] += offsets[v];
+        std::vector<GLuint> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < numIndices; ++i) triangles[fill[indices[i]]++] = GLuint(i / 3);
+    }
+};
+
+GLint
+skipDeadEnd(const std::vector<GLuint> &liveTriangles, std::vector<GLuint> &deadEnds,
+    GLuint &cursor, GLuint numVert)
+{
+    while (!deadEnds.empty()) {
+        GLuint v = deadEnds.back();
+        deadEnds.pop_back();
+        if (liveTriangles[v] > 0) return GLint(v);
+    }
+    while (cursor < numVert) {
+        if (liveTriangles[cursor] > 0) return GLint(cursor);
+        ++cursor;
+    }
+    return -1;
+}
+
+} // namespace
+
+void
+vcOptimizeVertexCache(GLuint *indices, size_t numIndices, GLuint numVert,
+    std::vector<size_t> *hardBoundaries, GLuint cacheSize)
+{
+    size_t numTriangles = numIndices / 3;
+    if (numTriangles == 0) return;
+
+    TriangleAdjacency adjacency(indices, numIndices, numVert);
+    std::vector<GLuint> liveTriangles(numVert);
+    for (GLuint v = 0; v < numVert; ++v) liveTriangles[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+    std::vector<size_t> cacheTime(numVert, 0);
+    std::vector<bool> emitted(numTriangles, false);
+    std::vector<GLuint> deadEnds;
+    std::vector<GLuint> candidates;
+    std::vector<GLuint> result;
+    result.reserve(numIndices);
+
+    size_t time = cacheSize + 1;
+    GLuint cursor = 0;
+    GLint fanVertex = 0;
+    if (hardBoundaries) {
+        hardBoundaries->clear();
+        hardBoundaries->push_back(0);
+    }
+
+    while (fanVertex >= 0) {
+        // emit all remaining triangles around the fanning vertex
+        candidates.clear();
+        for (GLuint a = adjacency.offsets[fanVertex]; a < adjacency.offsets[fanVertex + 1]; ++a) {
+            GLuint t = adjacency.triangles[a];
+            if (emitted[t]) continue;
+            for (int c = 0; c < 3; ++c) {
+                GLuint v = indices[t * 3 + c];
+                result.push_back(v);
+                deadEnds.push_back(v);
+                candidates.push_back(v);
+                --liveTriangles[v];
+                if (time - cacheTime[v] > cacheSize) cacheTime[v] = time++;
+            }
+            emitted[t] = true;
+        }
+
+        // next fanning vertex: the candidate that stays in the cache longest while its fan is emitted
+        GLint next = -1;
+        size_t bestPriority = 0;
+        for (auto v : candidates) {
+            if (liveTriangles[v] == 0) continue;
+            size_t priority = 0;
+            if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize) priority = time - cacheTime[v];
+            if (next < 0 || priority > bestPriority) {
+                bestPriority = priority;
+                next = GLint(v);
+            }
+        }
+        if (next < 0) {
+            next = skipDeadEnd(liveTriangles, deadEnds, cursor, numVert);
+            if (next >= 0 && hardBoundaries && result.size() < numIndices) hardBoundaries->push_back(result.size());
+        }
+        fanVertex = next;
+    }
+    std::copy(result.begin(), result.end(), indices);
+}
+
+void
+vcOptimizeOverdraw(GLuint *indices, size_t numIndices, const GLfloat *positions, GLuint numVert,
+    const std::vector<size_t> &hardBoundaries, float threshold, GLuint cacheSize)
+{
+    if (numIndices == 0) return;
+
+    // soft cluster boundaries: start a new cluster as soon as the running ACMR
+    // drops below threshold * ACMR of the enclosing hard cluster
+    std::vector<size_t> clusters;
+    std::vector<size_t> cacheTime(numVert, 0);
+    size_t time = cacheSize + 1;
+    for (size_t h = 0; h < hardBoundaries.size(); ++h) {
+        size_t begin = hardBoundaries[h];
+        size_t end = h + 1 < hardBoundaries.size() ? hardBoundaries[h + 1] : numIndices;
+        if (begin >= end) continue;
+        // ACMR of the hard cluster on its own, the time bump empties the cache
+        // without clearing cacheTime, so this stays linear in the number of indices
+        time += cacheSize + 1;
+        size_t hardMisses = 0;
+        for (size_t i = begin; i < end; ++i) {
+            GLuint v = indices[i];
+            if (time - cacheTime[v] > cacheSize) {
+                cacheTime[v] = time++;
+                ++hardMisses;
+            }
+        }
+        float clusterThreshold = threshold * float(hardMisses) / float((end - begin) / 3);
+
+        clusters.push_back(begin);
+        time += cacheSize + 1;
+        size_t misses = 0, triangles = 0;
+        for (size_t i = begin; i < end; i += 3) {
+            for (int c = 0; c < 3; ++c) {
+                GLuint v = indices[i + c];
+                if (time - cacheTime[v] > cacheSize) {
+                    cacheTime[v] = time++;
+                    ++misses;
+                }
+            }
+            ++triangles;
+            if (float(misses) / float(triangles) <= clusterThreshold && i + 3 < end) {
+                clusters.push_back(i + 3);
+                time += cacheSize + 1;
+                misses = triangles = 0;
+            }
+        }
+    }
+
+    // mesh centroid, area weighted over all triangles
+    double meshCentroid[3] = { 0, 0, 0 };
+    double meshArea = 0;
+    std::vector<float> clusterKey(clusters.size());
+    std::vector<float> clusterData(clusters.size() * 7, 0.f); // centroid * area, normal * area, area
+    for (size_t c = 0; c < clusters.size(); ++c) {
+        size_t begin = clusters[c];
+        size_t end = c + 1 < clusters.size() ? clusters[c + 1] : numIndices;
+        float *data = &clusterData[c * 7];
+        for (size_t i = begin; i < end; i += 3) {
+            const GLfloat *p0 = positions + indices[i] * 3;
+            const GLfloat *p1 = positions + indices[i + 1] * 3;
+            const GLfloat *p2 = positions + indices[i + 2] * 3;
+            float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+            float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+            float area = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            for (int k = 0; k < 3; ++k) {
+                data[k] += (p0[k] + p1[k] + p2[k]) / 3.f * area;
+                data[3 + k] += n[k];
+            }
+            data[6] += area;
+        }
+        for (int k = 0; k < 3; ++k) meshCentroid[k] += data[k];
+        meshArea += data[6];
+    }
+    if (meshArea > 0) {
+        for (int k = 0; k < 3; ++k) meshCentroid[k] /= meshArea;
+    }
+
+    // clusters facing away from the mesh center occlude the others, draw them first
+    for (size_t c = 0; c < clusters.size(); ++c) {
+        const float *data = &clusterData[c * 7];
+        float key = 0.f;
+        if (data[6] > 0.f) {
+            for (int k = 0; k < 3; ++k) {
+                key += (data[k] / data[6] - float(meshCentroid[k])) * data[3 + k];
+            }
+            key /= data[6];
+        }
+        clusterKey[c] = key;
+    }
+    std::vector<size_t> order(clusters.size());
+    for (size_t c = 0; c < order.size(); ++c) order[c] = c;
+    std::stable_sort(order.begin(), order.end(),
+        [&clusterKey](size_t a, size_t b) { return clusterKey[a] > clusterKey[b]; });
+
+    std::vector<GLuint> result;
+    result.reserve(numIndices);
+    for (auto c : order) {
+        size_t begin = clusters[c];
+        size_t end = c + 1 < clusters.size() ? clusters[c + 1] : numIndices;
+        result.insert(result.end(), indices + begin, indices + end);
+    }
+    std::copy(result.begin(), result.end(), indices);
+}
+
+GLuint
+vcOptimizeVertexFetch(GLuint *indices, size_t numIndices, GLuint numVert, std::vector<GLuint> &remap)
+{
+    remap.assign(numVert, ~0u);
+    GLuint next = 0;
+    for (size_t i = 0; i < numIndices; ++i) {
+        GLuint &v = remap[indices[i]];
+        if (v == ~0u) v = next++;
+        indices[i] = v;
+    }
+    return next;
+}
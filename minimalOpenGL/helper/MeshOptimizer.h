@@ -0,0 +1,39 @@
+/*
+*  CPU mesh optimizations for indexed triangle lists, run at load time.
+*
+*  vcOptimizeVertexCache reorders triangles for the post-transform vertex cache
+*  (Tipsify, Sander et al. 2007), vcOptimizeOverdraw reorders clusters of the
+*  result so that outward facing parts are drawn first and vcOptimizeVertexFetch
+*  renumbers vertices in order of first use.
+*  ACMR = vertex shader invocations / triangles, ATVR = invocations / vertices.
+*/
+
+#pragma once
+#include "GL/glew.h"
+#include <stddef.h>
+#include <vector>
+
+// size of the FIFO cache used for optimizing and measuring
+const GLuint VC_VERTEX_CACHE_SIZE = 16;
+
+// number of vertex shader invocations with a FIFO post-transform cache of cacheSize entries
+size_t vcSimulateVertexCache(const GLuint *indices, size_t numIndices, GLuint numVert,
+    GLuint cacheSize = VC_VERTEX_CACHE_SIZE);
+
+// reorders the triangles in place. if hardBoundaries is not null, it receives the
+// index offsets where the fan had to jump to an unconnected vertex (input of vcOptimizeOverdraw)
+void vcOptimizeVertexCache(GLuint *indices, size_t numIndices, GLuint numVert,
+    std::vector<size_t> *hardBoundaries = nullptr, GLuint cacheSize = VC_VERTEX_CACHE_SIZE);
+
+// splits the output of vcOptimizeVertexCache into clusters whose ACMR stays within
+// threshold of their hard cluster, and sorts them outside first.
+// positions are 3 floats per vertex
+void vcOptimizeOverdraw(GLuint *indices, size_t numIndices, const GLfloat *positions, GLuint numVert,
+    const std::vector<size_t> &hardBoundaries, float threshold = 1.05f,
+    GLuint cacheSize = VC_VERTEX_CACHE_SIZE);
+
+// renumbers vertices in order of first use and rewrites the indices,
+// remap[old vertex] = new vertex, unused vertices are dropped (remap = ~0u).
+// returns the number of used vertices
+GLuint vcOptimizeVertexFetch(GLuint *indices, size_t numIndices, GLuint numVert,
+    std::vector<GLuint> &remap);
@@ -0,0 +1,68 @@
+#include "Mipmaps.h"
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define VC_MIPMAP_SSE
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// _dst = 2x2 box filter of _src, rounded to nearest
+void
+downsampleLevel(const unsigned char *_src, int _srcWidth, int _srcHeight, unsigned char *_dst, int _dstWidth, int _dstHeight)
+{
+    size_t srcRow = (size_t)_srcWidth * 4;
+    for (int y = 0; y < _dstHeight; ++y) {
+        const unsigned char *row0 = _src + (size_t)std::min(2 * y, _srcHeight - 1) * srcRow;
+        const unsigned char *row1 = _src + (size_t)std::min(2 * y + 1, _srcHeight - 1) * srcRow;
+        unsigned char *dst = _dst + (size_t)y * _dstWidth * 4;
+        int x = 0;
+#ifdef VC_MIPMAP_SSE
+        // 4 destination pixels from 8x2 source pixels, summed in 16 bit
+        const __m128i zero = _mm_setzero_si128(), two = _mm_set1_epi16(2);
+        for (; 2 * x + 8 <= _srcWidth && x + 4 <= _dstWidth; x += 4) {
+            __m128i a0 = _mm_loadu_si128((const __m128i *)(row0 + 8 * x));
+            __m128i a1 = _mm_loadu_si128((const __m128i *)(row0 + 8 * x + 16));
+            __m128i b0 = _mm_loadu_si128((const __m128i *)(row1 + 8 * x));
+            __m128i b1 = _mm_loadu_si128((const __m128i *)(row1 + 8 * x + 16));
+            // vertical sums, two pixels per register
+            __m128i v0 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));
+            __m128i v1 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));
+            __m128i v2 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+            __m128i v3 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(b1, zero));
+            // horizontal neighbours
+            __m128i h0 = _mm_add_epi16(_mm_unpacklo_epi64(v0, v1), _mm_unpackhi_epi64(v0, v1));
+            __m128i h1 = _mm_add_epi16(_mm_unpacklo_epi64(v2, v3), _mm_unpackhi_epi64(v2, v3));
+            h0 = _mm_srli_epi16(_mm_add_epi16(h0, two), 2);
+            h1 = _mm_srli_epi16(_mm_add_epi16(h1, two), 2);
+            _mm_storeu_si128((__m128i *)(dst + 4 * x), _mm_packus_epi16(h0, h1));
+        }
+#endif
+        for (; x < _dstWidth; ++x) {
+            int x0 = std::min(2 * x, _srcWidth - 1) * 4, x1 = std::min(2 * x + 1, _srcWidth - 1) * 4;
+            for (int k = 0; k < 4; ++k) {
+                dst[4 * x + k] = (unsigned char)((row0[x0 + k] + row0[x1 + k] + row1[x0 + k] + row1[x1 + k] + 2) >> 2);
+            }
+        }
+    }
+}
+
+} // namespace
+
+std::vector<std::vector<unsigned char>>
+vcDownsample(const unsigned char *_pixels, int _width, int _height)
+{
+    std::vector<std::vector<unsigned char>> levels;
+    const unsigned char *src = _pixels;
+    int w = _width, h = _height;
+    while (w > 1 || h > 1) {
+        int dstWidth = std::max(1, w / 2), dstHeight = std::max(1, h / 2);
+        levels.push_back(std::vector<unsigned char>((size_t)dstWidth * dstHeight * 4));
+        downsampleLevel(src, w, h, levels.back().data(), dstWidth, dstHeight);
+        src = levels.back().data();
+        w = dstWidth;
+        h = dstHeight;
+    }
+    return levels;
+}
@@ -0,0 +1,12 @@
+/*
+*  Mipmap chains built on the CPU, used by the texture loader for OGL_MIPMAPS_CPU
+*  and by the texcompress tool. No GL in here.
+*/
+
+#pragma once
+#include <vector>
+
+// mipmap levels 1.. of a RGBA8 image down to 1x1, each a 2x2 box filter of the one above
+// (SSE2 where available). Level i is max(1, _width >> i) by max(1, _height >> i), odd sizes
+// repeat the last row/column. The rows keep the order of _pixels
+std::vector<std::vector<unsigned char>> vcDownsample(const unsigned char *_pixels, int _width, int _height);
@@ -6,17 +6,33 @@
 ////////////////////////////////////////////////////////////
 #pragma warning ( disable : 4996 ) 
 #include "OGLTexture.h"
+#include "BCnTexture.h"
+#include "MappedFile.h"
+#include "Mipmaps.h"
+#include "TextureLoader.h"
 #include <fstream>
 #include <vector>
 #include "rgbe.h"
 #include "stbi_image\stb_image.h"
 
+size_t OGLTexture::numDecoded = 0;
+
 OGLTexture::OGLTexture( bool _rectangular )
 {
 	ID = 0;
+	width = height = 0;
+	residentBytes = 0;
+	asyncPending = false;
 	if (_rectangular )
 		target = GL_TEXTURE_RECTANGLE_ARB; else
 		target = GL_TEXTURE_2D;
+	setFiltering( OGL_MIPMAPS_GPU, 8.0f );
+}
+
+void OGLTexture::setFiltering( OGLMipmaps _mipmaps, float _anisotropy )
+{
+	mipmaps = target == GL_TEXTURE_2D ? _mipmaps : OGL_MIPMAPS_NONE;
+	anisotropy = _anisotropy;
 }
 
 OGLTexture::~OGLTexture()
@@ -33,23 +49,47 @@ bool OGLTexture::createTexture()
 	ID ++;
 
 	glBindTexture  ( target, ID - 1 );
-	glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(target, GL_TEXTURE_MIN_FILTER, mipmaps != OGL_MIPMAPS_NONE ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
 	glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_REPEAT);
 	glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glGenerateMipmap(GL_TEXTURE_2D);
+	if( mipmaps != OGL_MIPMAPS_NONE && anisotropy > 1.0f && GLEW_EXT_texture_filter_anisotropic )
+	{
+		GLfloat maxAnisotropy = 1.0f;
+		glGetFloatv( GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &maxAnisotropy );
+		glTexParameterf( target, GL_TEXTURE_MAX_ANISOTROPY_EXT, anisotropy < maxAnisotropy ? anisotropy : maxAnisotropy );
+	}
+	// the mipmaps are made once there is an image, a 1x1 placeholder is complete without them
 
 	return true;
 }
 
+void OGLTexture::generateMipmaps()
+{
+	// OGL_MIPMAPS_CPU falls back to the GPU for the HDR loaders, loadTGA() builds its own with glu
+	if( mipmaps != OGL_MIPMAPS_NONE )
+		glGenerateMipmap( target );
+}
+
+size_t OGLTexture::withMipmaps( size_t _level0Bytes )
+{
+	return mipmaps != OGL_MIPMAPS_NONE ? _level0Bytes * 4 / 3 : _level0Bytes;
+}
+
 void OGLTexture::deleteTexture()
 {
+	if( asyncPending )
+	{
+		VC_TEXTURE_LOADER.cancel( this );
+		asyncPending = false;
+	}
 	if( ID )
 	{
 		ID --;
 		glDeleteTextures( 1, &ID );
 		ID = 0;
 	}
+	residentBytes = 0;
 }
 
 void OGLTexture::bind()
@@ -77,34 +117,66 @@ bool OGLTexture::load(char * filename )
 			);
 	}
 
-	/* the v coordinate has to be flipped when using stbi_image */
-	std::vector<unsigned char> img_flipped(w * h * 4);
-	for (int y = 0; y < h; y++) {
-		for (int x = 0; x < w; x++) {
-			for (int k = 0; k < 4; k++) {
-				img_flipped[(x + y * w) * 4 + k] = image_data[(x + (h - 1 - y) * w) * 4 + k];
-			}
-		}
+	// flipped row by row straight into the unpack buffer, sets width and height
+	std::vector<std::vector<unsigned char>> levels;
+	if( mipmaps == OGL_MIPMAPS_CPU )
+		levels = vcDownsample( image_data, w, h );
+	size_t copied = VC_TEXTURE_LOADER.upload( this, image_data, w, h, levels );
+	stbi_image_free(image_data);
+	numDecoded++;
+
+	fprintf(stderr, "[texture]: loaded '%s' (%zu bytes copied)\n", filename, copied);
+
+	return true;
+}
+
+bool OGLTexture::loadCompressed( char *filename )
+{
+	createTexture();
+
+	MappedFile file;
+	VCBCnFormat format;
+	std::vector<VCBCnLevel> levels;
+	if( !file.open( filename ) || !vcParseDDS( file.data(), file.size(), format, levels ) )
+	{
+		fprintf( stderr, "[texture]: error opening file '%s'\n", filename );
+		return false;
 	}
 
-	glTexImage2D(
-		target,
-		0,
-		GL_RGBA,
-		w,
-		h,
-		0,
-		GL_RGBA,
-		GL_UNSIGNED_BYTE,
-		img_flipped.data()
-		);
-	free(image_data);
-
-	fprintf(stderr, "[texture]: loaded '%s'\n", filename);
+	// the blocks go to the GL straight from the mapped file
+	GLenum internalFormat = format == VC_BC1 ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	size_t bytes = 0;
+	for( int level = 0; level < (int)levels.size(); level++ )
+	{
+		glCompressedTexImage2D( target, level, internalFormat, levels[ level ].width, levels[ level ].height, 0,
+			(GLsizei)levels[ level ].size, file.data() + levels[ level ].offset );
+		bytes += levels[ level ].size;
+	}
+	// compressed levels can't be generated, sample the ones the file has
+	glTexParameteri( target, GL_TEXTURE_MAX_LEVEL, (GLint)levels.size() - 1 );
+	width = levels[ 0 ].width;
+	height = levels[ 0 ].height;
+	residentBytes = bytes;
+
+	fprintf( stderr, "[texture]: loaded '%s' (%s, %d levels, %zu bytes)\n", filename,
+		format == VC_BC1 ? "BC1" : "BC3", (int)levels.size(), bytes );
 
 	return true;
 }
 
+void OGLTexture::loadAsync( const char *filename )
+{
+	createTexture();
+
+	const unsigned char grey[4] = { 128, 128, 128, 255 };
+	glTexImage2D( target, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey );
+	width = height = 1;
+	residentBytes = 4;
+
+	VC_TEXTURE_LOADER.request( this, filename );
+	asyncPending = true;
+}
+
 bool OGLTexture::loadHDR_RGBE( char *filename )
 {
 	createTexture();
@@ -141,6 +213,9 @@ bool OGLTexture::loadHDR_RGBE( char *filename )
 	fprintf( stderr, "[texture]: loaded '%s'\n", filename );
 
 	glTexImage2D( target, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data );
+	generateMipmaps();
+	residentBytes = withMipmaps( (size_t)width * height * 4 );
+	numDecoded++;
 	
 	delete data;
 
@@ -194,6 +269,9 @@ bool OGLTexture::loadHDR_FLOAT( char *filename )
 	fprintf( stderr, "[texture]: loaded '%s'\n", filename );
 
 	glTexImage2D( target, 0, GL_RGBA32F_ARB, width, height, 0, GL_RGBA, GL_FLOAT, fdata );
+	generateMipmaps();
+	residentBytes = withMipmaps( (size_t)width * height * 16 );
+	numDecoded++;
 	
 	delete data;
 	delete fdata;
@@ -356,6 +434,9 @@ bool OGLTexture::loadTGA( char *filename )
 		gluBuild2DMipmaps( target, 4, width, height, GL_RGBA, GL_UNSIGNED_BYTE, data ); 
 	else
 		gluBuild2DMipmaps( target, 3, width, height, GL_RGB,  GL_UNSIGNED_BYTE, data );
+	// glu always builds the whole chain
+	residentBytes = (size_t)width * height * 4 * 4 / 3;
+	numDecoded++;
 
 	delete[] data;
 
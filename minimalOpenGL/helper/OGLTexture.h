@@ -9,15 +9,34 @@
 #include "GL/glew.h"
 #include <GLFW/glfw3.h>
 
+// how the levels below the loaded image are made
+enum OGLMipmaps
+{
+	OGL_MIPMAPS_NONE,	// level 0 only, bilinear
+	OGL_MIPMAPS_GPU,	// glGenerateMipmap() after the upload
+	OGL_MIPMAPS_CPU		// box filtered on the loader threads, uploaded with level 0 (8 bit images only)
+};
+
 class OGLTexture
 {
 private:
 	void	deleteTexture();
 	bool	createTexture();
+	// the levels of OGL_MIPMAPS_GPU, called once level 0 holds the image
+	void	generateMipmaps();
+	// _level0Bytes plus a third for the mipmaps, if there are any
+	size_t	withMipmaps( size_t _level0Bytes );
 
 	GLenum	target;
 	int		width, height;
 	GLuint	ID;
+	bool	asyncPending; // queued in VC_TEXTURE_LOADER
+	OGLMipmaps	mipmaps;
+	float	anisotropy;
+	size_t	residentBytes; // all levels in GPU memory
+
+	// sets the size when the image of loadAsync() arrives
+	friend class VCTextureLoader;
 
 
 public:
@@ -25,6 +44,7 @@ public:
 	~OGLTexture();
 
 	GLuint	getID()      { return ID-1; };
+	GLenum	getTarget()  { return target; };
 	int		getWidth()   { return width; };
 	int		getHeight()  { return height; };
 	
@@ -32,6 +52,20 @@ public:
 	bool	loadHDR_FLOAT( char *filename );
 	bool	loadTGA		 ( char *fileName );
 	bool	load		 ( char *filename );
+	// BC1/BC3 .dds written by the texcompress tool, uploaded without decoding
+	bool	loadCompressed( char *filename );
+	// 1x1 grey until VC_TEXTURE_LOADER has decoded and uploaded the file, see helper/TextureLoader.h
+	void	loadAsync	 ( const char *filename );
+
+	// trilinear with _anisotropy samples (clamped to what the GPU supports, 1 turns it off)
+	// unless _mipmaps is OGL_MIPMAPS_NONE. Applies to the next load, rectangle textures
+	// never have mipmaps. The default is OGL_MIPMAPS_GPU and 8x anisotropy
+	void	setFiltering ( OGLMipmaps _mipmaps, float _anisotropy );
+	OGLMipmaps	getMipmaps() { return mipmaps; };
+	size_t	getResidentBytes() { return residentBytes; };
+
+	// images decoded from files and uploaded so far (sync and async), .dds files aren't decoded
+	static size_t	numDecoded;
 
 	void	bind();
 };
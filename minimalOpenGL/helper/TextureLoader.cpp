@@ -0,0 +1,219 @@
+#include "TextureLoader.h"
+#include "OGLTexture.h"
+#include "Mipmaps.h"
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+VCTextureLoader VC_TEXTURE_LOADER;
+
+namespace {
+
+double
+msSince(std::chrono::high_resolution_clock::time_point _start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - _start).count();
+}
+
+} // namespace
+
+VCTextureLoader::VCTextureLoader()
+{
+}
+
+VCTextureLoader::~VCTextureLoader()
+{
+    // GL objects are gone with the context at this point, only the threads are left
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_stop = true;
+    lock.unlock();
+    m_wake.notify_all();
+    for (auto &worker : m_workers) worker.join();
+}
+
+void
+VCTextureLoader::startWorkers()
+{
+    // leave one core to the GL thread
+    unsigned numWorkers = std::max(1u, std::min(4u, std::thread::hardware_concurrency() - 1));
+    for (unsigned i = 0; i < numWorkers; ++i) {
+        m_workers.push_back(std::thread(&VCTextureLoader::work, this));
+    }
+}
+
+void
+VCTextureLoader::request(OGLTexture *_texture, const std::string &_path)
+{
+    auto request = std::make_shared<Request>();
+    request->texture = _texture;
+    request->path = _path;
+    request->cpuMipmaps = _texture->mipmaps == OGL_MIPMAPS_CPU;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_workers.empty()) startWorkers();
+    m_queued.push_back(request);
+    lock.unlock();
+    m_wake.notify_one();
+}
+
+void
+VCTextureLoader::cancel(OGLTexture *_texture)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto list : { &m_queued, &m_decoded }) {
+        for (auto &request : *list) {
+            if (request->texture == _texture) request->texture = nullptr;
+        }
+    }
+    for (auto &request : m_decoding) {
+        if (request->texture == _texture) request->texture = nullptr;
+    }
+}
+
+size_t
+VCTextureLoader::numPending() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_queued.size() + m_decoding.size() + m_decoded.size();
+}
+
+void
+VCTextureLoader::work()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        m_wake.wait(lock, [this]() { return m_stop || !m_queued.empty(); });
+        if (m_stop) return;
+        std::shared_ptr<Request> request = m_queued.front();
+        m_queued.pop_front();
+        if (!request->texture) continue;
+        m_decoding.push_back(request);
+        lock.unlock();
+
+        auto startTime = std::chrono::high_resolution_clock::now();
+        int w = 0, h = 0, n = 0;
+        // kept as decoded, upload() flips it on the way into the unpack buffer
+        request->pixels.reset(stbi_load(request->path.c_str(), &w, &h, &n, 4));
+        request->width = w;
+        request->height = h;
+        request->failed = !request->pixels;
+        if (request->pixels && request->cpuMipmaps) {
+            request->levels = vcDownsample(request->pixels.get(), w, h);
+        }
+        request->decodeMs = msSince(startTime);
+
+        lock.lock();
+        m_decoding.erase(std::find(m_decoding.begin(), m_decoding.end(), request));
+        m_decoded.push_back(request);
+    }
+}
+
+void
+VCTextureLoader::update(double _budgetMs)
+{
+    auto startTime = std::chrono::high_resolution_clock::now();
+    bool uploaded = false;
+    for (;;) {
+        if (uploaded && msSince(startTime) >= _budgetMs) break;
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_decoded.empty()) break;
+        std::shared_ptr<Request> request = m_decoded.front();
+        m_decoded.pop_front();
+        bool queueEmpty = m_queued.empty() && m_decoding.empty() && m_decoded.empty();
+        lock.unlock();
+
+        OGLTexture *texture = request->texture;
+        if (texture) texture->asyncPending = false;
+        if (texture && request->failed) {
+            fprintf(stderr, "ERROR: could not load %s\n", request->path.c_str());
+        }
+        else if (texture) {
+            auto uploadStart = std::chrono::high_resolution_clock::now();
+            size_t bytes = upload(texture, request->pixels.get(), request->width, request->height, request->levels);
+            double uploadMs = msSince(uploadStart);
+            m_uploadMs += uploadMs;
+            m_bytesUploaded += bytes;
+            ++m_numUploaded;
+            ++OGLTexture::numDecoded;
+            uploaded = true;
+            fprintf(stderr, "[texture]: loaded '%s' (decode %.1f ms, upload %.1f ms, %zu bytes copied)\n",
+                request->path.c_str(), request->decodeMs, uploadMs, bytes);
+        }
+        request->pixels.reset();
+        request->levels.clear();
+
+        if (queueEmpty && m_numUploaded > 0) {
+            fprintf(stderr, "[texture]: %u textures uploaded in %.1f ms, %zu bytes copied\n",
+                (unsigned)m_numUploaded, m_uploadMs, m_bytesUploaded);
+        }
+    }
+}
+
+void
+VCTextureLoader::shutdown()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_stop = true;
+    lock.unlock();
+    m_wake.notify_all();
+    for (auto &worker : m_workers) worker.join();
+    m_workers.clear();
+    for (auto list : { &m_queued, &m_decoded }) {
+        for (auto &request : *list) {
+            if (request->texture) request->texture->asyncPending = false;
+        }
+        list->clear();
+    }
+    for (auto &request : m_decoding) {
+        if (request->texture) request->texture->asyncPending = false;
+    }
+    m_decoding.clear();
+    if (m_unpackBO) {
+        glDeleteBuffers(1, &m_unpackBO);
+        m_unpackBO = 0;
+    }
+}
+
+size_t
+VCTextureLoader::upload(OGLTexture *_texture, const unsigned char *_pixels, int _width, int _height,
+    const std::vector<std::vector<unsigned char>> &_levels)
+{
+    GLsizeiptr size = (GLsizeiptr)_width * _height * 4;
+    for (auto &level : _levels) size += (GLsizeiptr)level.size();
+    if (!m_unpackBO) glGenBuffers(1, &m_unpackBO);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_unpackBO);
+    // orphaned, so the copy doesn't wait for the previous upload
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    unsigned char *dst = (unsigned char *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    size_t copied = 0;
+    _texture->bind();
+    if (dst) {
+        // all levels in one buffer, each specified from its offset
+        std::vector<size_t> offsets;
+        for (int level = 0; level <= (int)_levels.size(); ++level) {
+            const unsigned char *src = level ? _levels[level - 1].data() : _pixels;
+            int w = std::max(1, _width >> level), h = std::max(1, _height >> level);
+            size_t rowBytes = (size_t)w * 4;
+            offsets.push_back(copied);
+            /* the v coordinate has to be flipped when using stbi_image */
+            for (int y = 0; y < h; ++y) {
+                memcpy(dst + copied + (size_t)y * rowBytes, src + (size_t)(h - 1 - y) * rowBytes, rowBytes);
+            }
+            copied += rowBytes * h;
+        }
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        for (int level = 0; level <= (int)_levels.size(); ++level) {
+            glTexImage2D(_texture->getTarget(), level, GL_RGBA, std::max(1, _width >> level), std::max(1, _height >> level),
+                0, GL_RGBA, GL_UNSIGNED_BYTE, (const void *)offsets[level]);
+        }
+        if (_levels.empty()) _texture->generateMipmaps();
+        _texture->width = _width;
+        _texture->height = _height;
+        _texture->residentBytes = _levels.empty() ? _texture->withMipmaps(copied) : copied;
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    return copied;
+}
@@ -0,0 +1,83 @@
+/*
+*  Asynchronous texture loading.
+*
+*  OGLTexture::loadAsync() gives the texture a 1x1 grey placeholder and queues the
+*  file. Worker threads decode it with stb_image. update() runs on the GL thread
+*  once per frame. It uploads decoded images through a pixel unpack buffer into the
+*  same texture name, so whatever already uses the texture ID shows the real image
+*  from then on. Each update() stops starting new uploads once its time budget is
+*  used up, at least one upload always goes through.
+*
+*  upload() is also what OGLTexture::load() uses. stb_image decodes top row first,
+*  the rows are flipped while they are copied into the mapped buffer, so the decoded
+*  image is copied exactly once and never duplicated in client memory.
+*
+*  Textures set to OGL_MIPMAPS_CPU get their mipmaps box filtered on the worker
+*  (vcDownsample() in Mipmaps.h) and uploaded together with level 0, the
+*  others are given glGenerateMipmap() after the upload.
+*/
+
+#pragma once
+#include "GL/glew.h"
+#include "stbi_image/stb_image.h"
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class OGLTexture;
+
+class VCTextureLoader {
+public:
+    VCTextureLoader();
+    ~VCTextureLoader();
+
+    // decodes _path on a worker thread and uploads it into _texture in a later update(),
+    // the texture must already hold its placeholder and its filtering settings
+    void request(OGLTexture *_texture, const std::string &_path);
+    // forgets the requests of _texture, called when it is deleted or loaded again
+    void cancel(OGLTexture *_texture);
+    // uploads decoded images until _budgetMs is spent, call once per frame on the GL thread
+    void update(double _budgetMs);
+    // requests not uploaded yet
+    size_t numPending() const;
+    // stops the workers and deletes the unpack buffer, call before the GL context goes away
+    void shutdown();
+    // specifies level 0 of _texture from the RGBA8 image _pixels (top row first, as
+    // stb_image decodes it) and levels 1.. from _levels, or generates them when _levels
+    // is empty. Returns the bytes copied into the unpack buffer. GL thread only
+    size_t upload(OGLTexture *_texture, const unsigned char *_pixels, int _width, int _height,
+        const std::vector<std::vector<unsigned char>> &_levels = std::vector<std::vector<unsigned char>>());
+
+private:
+    struct Request {
+        OGLTexture *texture = nullptr; // nullptr once cancelled
+        std::string path;
+        std::unique_ptr<unsigned char, void (*)(void *)> pixels{ nullptr, stbi_image_free }; // RGBA8 from stbi_load()
+        std::vector<std::vector<unsigned char>> levels; // OGL_MIPMAPS_CPU only
+        int width = 0, height = 0;
+        bool cpuMipmaps = false, failed = false;
+        double decodeMs = 0.0;
+    };
+
+    void startWorkers();
+    void work();
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::deque<std::shared_ptr<Request>> m_queued; // waiting for a worker
+    std::deque<std::shared_ptr<Request>> m_decoded; // waiting for update()
+    std::vector<std::shared_ptr<Request>> m_decoding; // on a worker
+    std::vector<std::thread> m_workers;
+    bool m_stop = false;
+
+    GLuint m_unpackBO = 0;
+    double m_uploadMs = 0.0; // sums over all async uploads, printed when the queue runs empty
+    size_t m_numUploaded = 0;
+    size_t m_bytesUploaded = 0;
+};
+
+extern VCTextureLoader VC_TEXTURE_LOADER;
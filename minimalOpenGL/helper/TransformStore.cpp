@@ -0,0 +1,186 @@
+#include "TransformStore.h"
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define VC_TRANSFORM_SSE
+#include <xmmintrin.h>
+#endif
+
+GLuint
+VCTransformStore::create()
+{
+    if (m_freeSlots.empty()) {
+        // grow by four slots, the batch update always works on whole blocks
+        size_t n = m_dirty.size() + 4;
+        for (auto v : { &m_tx, &m_ty, &m_tz, &m_qx, &m_qy, &m_qz }) v->resize(n, 0.f);
+        for (auto v : { &m_qw, &m_sx, &m_sy, &m_sz }) v->resize(n, 1.f);
+        m_modelMats.resize(n, glm::mat4(1.f));
+        m_normalMats.resize(n, glm::mat3(1.f));
+        m_dirty.resize(n, 0);
+        for (GLuint i = GLuint(n); i > GLuint(n - 4); --i) m_freeSlots.push_back(i - 1);
+    }
+    GLuint slot = m_freeSlots.back();
+    m_freeSlots.pop_back();
+    setTranslation(slot, glm::vec3(0.f));
+    setRotation(slot, glm::quat());
+    setScaleFactor(slot, glm::vec3(1.f));
+    return slot;
+}
+
+void
+VCTransformStore::release(GLuint slot)
+{
+    m_freeSlots.push_back(slot);
+}
+
+glm::vec3
+VCTransformStore::translation(GLuint slot) const
+{
+    return glm::vec3(m_tx[slot], m_ty[slot], m_tz[slot]);
+}
+
+glm::quat
+VCTransformStore::rotation(GLuint slot) const
+{
+    return glm::quat(m_qw[slot], m_qx[slot], m_qy[slot], m_qz[slot]);
+}
+
+glm::vec3
+VCTransformStore::scaleFactor(GLuint slot) const
+{
+    return glm::vec3(m_sx[slot], m_sy[slot], m_sz[slot]);
+}
+
+void
+VCTransformStore::setTranslation(GLuint slot, const glm::vec3 &t)
+{
+    m_tx[slot] = t.x; m_ty[slot] = t.y; m_tz[slot] = t.z;
+    m_dirty[slot] = 1;
+}
+
+void
+VCTransformStore::setRotation(GLuint slot, const glm::quat &q)
+{
+    m_qx[slot] = q.x; m_qy[slot] = q.y; m_qz[slot] = q.z; m_qw[slot] = q.w;
+    m_dirty[slot] = 1;
+}
+
+void
+VCTransformStore::setScaleFactor(GLuint slot, const glm::vec3 &s)
+{
+    m_sx[slot] = s.x; m_sy[slot] = s.y; m_sz[slot] = s.z;
+    m_dirty[slot] = 1;
+}
+
+const glm::mat4&
+VCTransformStore::modelMat(GLuint slot)
+{
+    if (m_dirty[slot]) updateSlot(slot);
+    return m_modelMats[slot];
+}
+
+const glm::mat3&
+VCTransformStore::normalMat(GLuint slot)
+{
+    if (m_dirty[slot]) updateSlot(slot);
+    return m_normalMats[slot];
+}
+
+// same math as the SSE path in update(), rotation matrix of a unit quaternion
+void
+VCTransformStore::updateSlot(GLuint slot)
+{
+    float x = m_qx[slot], y = m_qy[slot], z = m_qz[slot], w = m_qw[slot];
+    float r[3][3] = {
+        { 1.f - 2.f * (y * y + z * z), 2.f * (x * y + w * z), 2.f * (x * z - w * y) },
+        { 2.f * (x * y - w * z), 1.f - 2.f * (x * x + z * z), 2.f * (y * z + w * x) },
+        { 2.f * (x * z + w * y), 2.f * (y * z - w * x), 1.f - 2.f * (x * x + y * y) } };
+    float s[3] = { m_sx[slot], m_sy[slot], m_sz[slot] };
+
+    glm::mat4 &mm = m_modelMats[slot];
+    glm::mat3 &nm = m_normalMats[slot];
+    for (int c = 0; c < 3; ++c) {
+        for (int k = 0; k < 3; ++k) {
+            mm[c][k] = r[c][k] * s[c];
+            nm[c][k] = r[c][k] / s[c];
+        }
+        mm[c][3] = 0.f;
+    }
+    mm[3] = glm::vec4(m_tx[slot], m_ty[slot], m_tz[slot], 1.f);
+    m_dirty[slot] = 0;
+}
+
+#ifdef VC_TRANSFORM_SSE
+namespace {
+
+inline void
+store3(float *p, __m128 v)
+{
+    _mm_storel_pi((__m64 *)p, v);
+    _mm_store_ss(p + 2, _mm_movehl_ps(v, v));
+}
+
+} // namespace
+#endif
+
+void
+VCTransformStore::update()
+{
+    for (size_t i = 0; i < m_dirty.size(); i += 4) {
+        uint32_t dirty;
+        memcpy(&dirty, &m_dirty[i], sizeof(dirty));
+        if (!dirty) continue;
+
+#ifdef VC_TRANSFORM_SSE
+        // one lane per slot
+        __m128 x = _mm_loadu_ps(&m_qx[i]), y = _mm_loadu_ps(&m_qy[i]);
+        __m128 z = _mm_loadu_ps(&m_qz[i]), w = _mm_loadu_ps(&m_qw[i]);
+        __m128 one = _mm_set1_ps(1.f), two = _mm_set1_ps(2.f);
+        __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+        __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+        __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+        // r[column][row]
+        __m128 r[3][3];
+        r[0][0] = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz)));
+        r[0][1] = _mm_mul_ps(two, _mm_add_ps(xy, wz));
+        r[0][2] = _mm_mul_ps(two, _mm_sub_ps(xz, wy));
+        r[1][0] = _mm_mul_ps(two, _mm_sub_ps(xy, wz));
+        r[1][1] = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz)));
+        r[1][2] = _mm_mul_ps(two, _mm_add_ps(yz, wx));
+        r[2][0] = _mm_mul_ps(two, _mm_add_ps(xz, wy));
+        r[2][1] = _mm_mul_ps(two, _mm_sub_ps(yz, wx));
+        r[2][2] = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy)));
+
+        __m128 s[3] = { _mm_loadu_ps(&m_sx[i]), _mm_loadu_ps(&m_sy[i]), _mm_loadu_ps(&m_sz[i]) };
+        for (int c = 0; c < 3; ++c) {
+            __m128 invS = _mm_div_ps(one, s[c]);
+            // model column c and normal column c of the four slots, transposed to one register per slot
+            __m128 m0 = _mm_mul_ps(r[c][0], s[c]), m1 = _mm_mul_ps(r[c][1], s[c]);
+            __m128 m2 = _mm_mul_ps(r[c][2], s[c]), m3 = _mm_setzero_ps();
+            __m128 n0 = _mm_mul_ps(r[c][0], invS), n1 = _mm_mul_ps(r[c][1], invS);
+            __m128 n2 = _mm_mul_ps(r[c][2], invS), n3 = _mm_setzero_ps();
+            _MM_TRANSPOSE4_PS(m0, m1, m2, m3);
+            _MM_TRANSPOSE4_PS(n0, n1, n2, n3);
+            __m128 mcol[4] = { m0, m1, m2, m3 };
+            __m128 ncol[4] = { n0, n1, n2, n3 };
+            for (int k = 0; k < 4; ++k) {
+                _mm_storeu_ps(&m_modelMats[i + k][c][0], mcol[k]);
+                store3(&m_normalMats[i + k][c][0], ncol[k]);
+            }
+        }
+        __m128 t0 = _mm_loadu_ps(&m_tx[i]), t1 = _mm_loadu_ps(&m_ty[i]);
+        __m128 t2 = _mm_loadu_ps(&m_tz[i]), t3 = one;
+        _MM_TRANSPOSE4_PS(t0, t1, t2, t3);
+        _mm_storeu_ps(&m_modelMats[i + 0][3][0], t0);
+        _mm_storeu_ps(&m_modelMats[i + 1][3][0], t1);
+        _mm_storeu_ps(&m_modelMats[i + 2][3][0], t2);
+        _mm_storeu_ps(&m_modelMats[i + 3][3][0], t3);
+        memset(&m_dirty[i], 0, 4);
+#else
+        for (size_t k = i; k < i + 4; ++k) {
+            if (m_dirty[k]) updateSlot(GLuint(k));
+        }
+#endif
+    }
+}
@@ -0,0 +1,50 @@
+/*
+*  Structure of arrays storage for the translation/rotation/scale of every VCModel.
+*
+*  Each transform is a slot index. The components live in one float array per
+*  component, so update() can build the model and normal matrices of four slots
+*  at once with SSE. Slots are allocated in blocks of four, so the batch loop
+*  has no scalar tail. Matrices of a changed slot are rebuilt either by the next
+*  update() or on the first access, whichever comes first.
+*/
+
+#pragma once
+#include "GL/glew.h"
+#include <glm.hpp>
+#include <gtc/quaternion.hpp>
+#include <stdint.h>
+#include <vector>
+
+class VCTransformStore {
+public:
+    // returns a slot with the identity transform
+    GLuint create();
+    void release(GLuint slot);
+
+    glm::vec3 translation(GLuint slot) const;
+    glm::quat rotation(GLuint slot) const;
+    glm::vec3 scaleFactor(GLuint slot) const;
+    void setTranslation(GLuint slot, const glm::vec3 &t);
+    void setRotation(GLuint slot, const glm::quat &q);
+    void setScaleFactor(GLuint slot, const glm::vec3 &s);
+
+    // rebuilt on access if the slot changed since the last update()
+    const glm::mat4& modelMat(GLuint slot);
+    // inverse transpose of the upper 3x3 of modelMat, R * S^-1
+    const glm::mat3& normalMat(GLuint slot);
+
+    // rebuilds the matrices of all changed slots, call once per frame before drawing
+    void update();
+    size_t size() const { return m_dirty.size(); }
+
+private:
+    void updateSlot(GLuint slot);
+
+    std::vector<float> m_tx, m_ty, m_tz;
+    std::vector<float> m_qx, m_qy, m_qz, m_qw;
+    std::vector<float> m_sx, m_sy, m_sz;
+    std::vector<glm::mat4> m_modelMats;
+    std::vector<glm::mat3> m_normalMats;
+    std::vector<uint8_t> m_dirty;
+    std::vector<GLuint> m_freeSlots;
+};
@@ -8,7 +8,13 @@
 #include "GLMmodel.h"
 #include <glm.hpp>
 #include <assert.h>
+#include <math.h>
 #include <stdio.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../MappedFile.h"
 
 using namespace std;
 
@@ -22,14 +28,6 @@ enum { X, Y, Z, W };			/* elements of a vertex */
 
 /* typedefs */
 
-/* _GLMnode: general purpose node
- */
-typedef struct _GLMnode {
-  GLuint           index;
-  GLboolean        averaged;
-  struct _GLMnode* next;
-} GLMnode;
-
 
 /* private functions */
 
@@ -131,6 +129,130 @@ _glmEqual(GLfloat* u, GLfloat* v, GLfloat epsilon)
   return GL_FALSE;
 }
 
+/* _GLMblock: a block of arena memory, the data follows the header
+ */
+typedef struct _GLMblock {
+  struct _GLMblock* next;		/* next (older) block */
+  size_t size;				/* bytes of data */
+  size_t used;				/* bytes of data handed out */
+  GLuint numallocs;			/* allocations in this block */
+} GLMblock;
+
+#define GLM_ARENA_ALIGN    16		/* alignment of all allocations */
+#define GLM_ARENA_BLOCK    (1 << 16)	/* size of a shared block */
+#define GLM_ARENA_HEADER   ((sizeof(GLMblock) + GLM_ARENA_ALIGN - 1) & ~(size_t)(GLM_ARENA_ALIGN - 1))
+
+/* _glmAlloc: allocate memory that lives as long as the model.  Small
+ * requests are bumped off the newest block, big ones (vertex and
+ * triangle arrays) get a block of their own, which is linked behind
+ * the newest block so that its free space is not lost.
+ *
+ * model - model that owns the memory
+ * size  - number of bytes
+ */
+static GLvoid*
+_glmAlloc(GLMmodel* model, size_t size)
+{
+  GLMarena* arena = &model->arena;
+  GLMblock* block = arena->blocks;
+  char*     data;
+
+  size = (size + GLM_ARENA_ALIGN - 1) & ~(size_t)(GLM_ARENA_ALIGN - 1);
+
+  if (!block || block->size - block->used < size) {
+    GLboolean own = size > GLM_ARENA_BLOCK / 4;
+    size_t    blocksize = own ? size : GLM_ARENA_BLOCK;
+
+    GLMblock* newblock = (GLMblock*)malloc(GLM_ARENA_HEADER + blocksize);
+    if (!newblock) {
+      fprintf(stderr, "_glmAlloc() failed: out of memory (%lu bytes).\n",
+	      (unsigned long)size);
+      exit(1);
+    }
+    newblock->size = blocksize;
+    newblock->used = 0;
+    newblock->numallocs = 0;
+    if (own && block) {
+      newblock->next = block->next;
+      block->next = newblock;
+    } else {
+      newblock->next = block;
+      arena->blocks = newblock;
+    }
+    block = newblock;
+    arena->numblocks++;
+    arena->reserved += GLM_ARENA_HEADER + blocksize;
+    if (arena->peak < arena->reserved)
+      arena->peak = arena->reserved;
+  }
+
+  data = (char*)block + GLM_ARENA_HEADER + block->used;
+  block->used += size;
+  block->numallocs++;
+  arena->used += size;
+  arena->numallocs++;
+
+  return data;
+}
+
+/* _glmStrdup: strdup() into the arena of the model
+ */
+static char*
+_glmStrdup(GLMmodel* model, const char* s)
+{
+  size_t length = strlen(s) + 1;
+  char*  copy = (char*)_glmAlloc(model, length);
+
+  memcpy(copy, s, length);
+  return copy;
+}
+
+/* _glmFree: give memory from _glmAlloc() back before the model is
+ * deleted.  Only a block that holds nothing else (a big array that is
+ * replaced, e.g. by glmWeld()) is actually released, everything else
+ * stays until glmDelete().
+ *
+ * model - model that owns the memory
+ * p     - pointer returned by _glmAlloc() or NULL
+ */
+static GLvoid
+_glmFree(GLMmodel* model, GLvoid* p)
+{
+  GLMarena*  arena = &model->arena;
+  GLMblock** link;
+
+  if (!p)
+    return;
+
+  for (link = &arena->blocks; *link; link = &(*link)->next) {
+    GLMblock* block = *link;
+    if ((char*)block + GLM_ARENA_HEADER == (char*)p) {
+      if (block->numallocs == 1) {
+	*link = block->next;
+	arena->used -= block->used;
+	arena->reserved -= GLM_ARENA_HEADER + block->size;
+	free(block);
+      }
+      return;
+    }
+  }
+}
+
+/* _glmTrackPeak: account for temporary memory the model is built from
+ * (parse buffers, welded copies) in the peak of the arena.
+ *
+ * model - model being built
+ * bytes - size of the temporary memory that is alive right now
+ */
+static GLvoid
+_glmTrackPeak(GLMmodel* model, size_t bytes)
+{
+  GLMarena* arena = &model->arena;
+
+  if (arena->peak < arena->reserved + bytes)
+    arena->peak = arena->reserved + bytes;
+}
+
 /* _glmWeldVectors: eliminate (weld) vectors that are within an
  * epsilon of each other.
  *
@@ -149,7 +271,7 @@ _glmWeldVectors(GLfloat* vectors, GLuint* numvectors, GLfloat epsilon)
   copies = (GLfloat*)malloc(sizeof(GLfloat) * 3 * (*numvectors + 1));
   memcpy(copies, vectors, (sizeof(GLfloat) * 3 * (*numvectors + 1)));
 
-  copied = 1;
+  copied = 0;
   for (i = 1; i <= *numvectors; i++) {
     for (j = 1; j <= copied; j++) {
       if (_glmEqual(&vectors[3 * i], &copies[3 * j], epsilon)) {
@@ -158,11 +280,11 @@ _glmWeldVectors(GLfloat* vectors, GLuint* numvectors, GLfloat epsilon)
     }
 
     /* must not be any duplicates -- add to the copies array */
+    copied++;
     copies[3 * copied + 0] = vectors[3 * i + 0];
     copies[3 * copied + 1] = vectors[3 * i + 1];
     copies[3 * copied + 2] = vectors[3 * i + 2];
     j = copied;				/* pass this along for below */
-    copied++;
 
   duplicate:
     /* set the first component of this vector to point at the correct
@@ -170,10 +292,303 @@ _glmWeldVectors(GLfloat* vectors, GLuint* numvectors, GLfloat epsilon)
     vectors[3 * i + 0] = (GLfloat)j;
   }
 
-  *numvectors = copied-1;
+  *numvectors = copied;
   return copies;
 }
 
+/* _glmParallelFor: call func(first, last) on numthreads consecutive
+ * ranges of [first, last) = [0, count), each on its own thread.
+ * Small counts are processed on the calling thread.
+ *
+ * numthreads - number of threads, 0 = one per core
+ */
+template <typename Func>
+static GLvoid
+_glmParallelFor(GLuint count, GLuint numthreads, Func func)
+{
+  vector<thread> threads;
+  GLuint i;
+
+  if (numthreads == 0)
+    numthreads = thread::hardware_concurrency();
+  if (numthreads > count / 4096 + 1)
+    numthreads = count / 4096 + 1;
+  if (numthreads <= 1) {
+    func(0, count);
+    return;
+  }
+  for (i = 0; i < numthreads; i++)
+    threads.push_back(thread(func, (GLuint)((unsigned long long)count * i / numthreads),
+			     (GLuint)((unsigned long long)count * (i + 1) / numthreads)));
+  for (i = 0; i < threads.size(); i++)
+    threads[i].join();
+}
+
+/* _GLMgrid: uniform grid over an array of GLfloat[3]'s.  Cells are
+ * hashed into a power of two number of buckets, bucket b holds the
+ * vector indices indices[offsets[b]] .. indices[offsets[b + 1] - 1]
+ * in ascending order.
+ */
+typedef struct _GLMgrid {
+  double         cellsize;
+  GLuint         mask;
+  vector<GLuint> offsets;
+  vector<GLuint> indices;
+} GLMgrid;
+
+/* _glmGridCell: cell coordinates of vector v */
+static GLvoid
+_glmGridCell(const GLMgrid& grid, const GLfloat* v, long long* cell)
+{
+  int i;
+  for (i = 0; i < 3; i++) {
+    double c = floor(v[i] / grid.cellsize);
+    if (c > 4e18) c = 4e18;
+    if (c < -4e18) c = -4e18;
+    cell[i] = (long long)c;
+  }
+}
+
+/* _glmGridBucket: bucket of a cell */
+static GLuint
+_glmGridBucket(const GLMgrid& grid, long long x, long long y, long long z)
+{
+  unsigned long long h = (unsigned long long)x * 73856093ull ^
+    (unsigned long long)y * 19349663ull ^ (unsigned long long)z * 83492791ull;
+  return (GLuint)(h ^ (h >> 32)) & grid.mask;
+}
+
+/* _glmBuildGrid: sort vectors 1 .. numvectors into a grid of cells
+ * slightly larger than epsilon, so that vectors within epsilon of
+ * each other are at most one cell apart on every axis.
+ */
+static GLvoid
+_glmBuildGrid(GLMgrid& grid, GLfloat* vectors, GLuint numvectors,
+	      GLfloat epsilon, GLuint numthreads)
+{
+  vector<GLuint> buckets(numvectors + 1);
+  GLuint numbuckets = 1;
+  GLuint i;
+
+  while (numbuckets < 2 * numvectors && numbuckets < (1u << 30))
+    numbuckets <<= 1;
+  grid.cellsize = (double)epsilon * 1.001;
+  grid.mask = numbuckets - 1;
+
+  _glmParallelFor(numvectors, numthreads, [&](GLuint first, GLuint last) {
+    long long cell[3];
+    GLuint v;
+    for (v = first + 1; v <= last; v++) {
+      _glmGridCell(grid, &vectors[3 * v], cell);
+      buckets[v] = _glmGridBucket(grid, cell[0], cell[1], cell[2]);
+    }
+  });
+
+  /* counting sort, keeps the indices of a bucket in ascending order */
+  grid.offsets.assign(numbuckets + 1, 0);
+  grid.indices.resize(numvectors);
+  for (i = 1; i <= numvectors; i++)
+    grid.offsets[buckets[i] + 1]++;
+  for (i = 0; i < numbuckets; i++)
+    grid.offsets[i + 1] += grid.offsets[i];
+  vector<GLuint> fill(grid.offsets.begin(), grid.offsets.end() - 1);
+  for (i = 1; i <= numvectors; i++)
+    grid.indices[fill[buckets[i]]++] = i;
+}
+
+/* _glmGridFind: returns the smallest index k < i for which vector k
+ * is within epsilon of vector i, 0 if there is none.
+ */
+static GLuint
+_glmGridFind(const GLMgrid& grid, GLfloat* vectors, GLuint i, GLfloat epsilon)
+{
+  long long cell[3];
+  GLuint    found = 0;
+  int       dx, dy, dz;
+
+  _glmGridCell(grid, &vectors[3 * i], cell);
+  for (dx = -1; dx <= 1; dx++)
+    for (dy = -1; dy <= 1; dy++)
+      for (dz = -1; dz <= 1; dz++) {
+	GLuint b = _glmGridBucket(grid, cell[0] + dx, cell[1] + dy, cell[2] + dz);
+	GLuint e;
+	for (e = grid.offsets[b]; e < grid.offsets[b + 1]; e++) {
+	  GLuint k = grid.indices[e];
+	  if (k >= i || (found && k >= found))
+	    break;
+	  if (_glmEqual(&vectors[3 * i], &vectors[3 * k], epsilon)) {
+	    found = k;
+	    break;
+	  }
+	}
+      }
+  return found;
+}
+
+/* _glmGridFindKept: like _glmGridFind(), but only searches the kept
+ * vectors, which are linked per bucket through kepthead/keptnext.
+ */
+static GLuint
+_glmGridFindKept(const GLMgrid& grid, const vector<GLuint>& kepthead,
+		 const vector<GLuint>& keptnext, GLfloat* vectors, GLuint i,
+		 GLfloat epsilon)
+{
+  long long cell[3];
+  GLuint    found = 0;
+  int       dx, dy, dz;
+
+  _glmGridCell(grid, &vectors[3 * i], cell);
+  for (dx = -1; dx <= 1; dx++)
+    for (dy = -1; dy <= 1; dy++)
+      for (dz = -1; dz <= 1; dz++) {
+	GLuint k = kepthead[_glmGridBucket(grid, cell[0] + dx, cell[1] + dy, cell[2] + dz)];
+	for (; k; k = keptnext[k]) {
+	  if ((!found || k < found) && _glmEqual(&vectors[3 * i], &vectors[3 * k], epsilon))
+	    found = k;
+	}
+      }
+  return found;
+}
+
+/* _glmWeldVectorsGrid: same result as _glmWeldVectors() in expected
+ * linear time.  Candidates are only searched in the neighbouring grid
+ * cells.  The first vector within epsilon is searched on numthreads
+ * threads; if that one was welded itself, the kept vectors are
+ * searched serially.  Instead of overwriting vectors, the index of
+ * the copy of every vector is stored in remap[1 .. numvectors].
+ *
+ * vectors    - array of GLfloat[3]'s to be welded
+ * numvectors - number of GLfloat[3]'s in vectors
+ * epsilon    - maximum difference between vectors
+ * numthreads - number of threads, 0 = one per core
+ * remap      - array of numvectors + 1 GLuints
+ */
+static GLfloat*
+_glmWeldVectorsGrid(GLfloat* vectors, GLuint* numvectors, GLfloat epsilon,
+		    GLuint numthreads, GLuint* remap)
+{
+  GLMgrid        grid;
+  vector<GLuint> first(*numvectors + 1, 0);
+  vector<GLuint> copyof(*numvectors + 1, 0);	/* copy index of kept vectors, 0 otherwise */
+  vector<GLuint> kepthead, keptnext;
+  GLfloat*       copies;
+  GLuint         copied;
+  GLuint         i;
+
+  copies = (GLfloat*)malloc(sizeof(GLfloat) * 3 * (*numvectors + 1));
+  memcpy(copies, vectors, sizeof(GLfloat) * 3);
+
+  /* _glmEqual() is strict, nothing is within a non-positive epsilon */
+  if (epsilon > 0.0f) {
+    _glmBuildGrid(grid, vectors, *numvectors, epsilon, numthreads);
+    kepthead.assign(grid.mask + 1, 0);
+    keptnext.assign(*numvectors + 1, 0);
+    _glmParallelFor(*numvectors, numthreads, [&](GLuint lo, GLuint hi) {
+      GLuint v;
+      for (v = lo + 1; v <= hi; v++)
+	first[v] = _glmGridFind(grid, vectors, v, epsilon);
+    });
+  }
+
+  copied = 0;
+  for (i = 1; i <= *numvectors; i++) {
+    GLuint match = first[i];
+    if (match && !copyof[match])
+      match = _glmGridFindKept(grid, kepthead, keptnext, vectors, i, epsilon);
+    if (match) {
+      remap[i] = copyof[match];
+      continue;
+    }
+
+    copied++;
+    copyof[i] = remap[i] = copied;
+    copies[3 * copied + 0] = vectors[3 * i + 0];
+    copies[3 * copied + 1] = vectors[3 * i + 1];
+    copies[3 * copied + 2] = vectors[3 * i + 2];
+    if (epsilon > 0.0f) {
+      long long cell[3];
+      GLuint    b;
+      _glmGridCell(grid, &vectors[3 * i], cell);
+      b = _glmGridBucket(grid, cell[0], cell[1], cell[2]);
+      keptnext[i] = kepthead[b];
+      kepthead[b] = i;
+    }
+  }
+
+  *numvectors = copied;
+  return copies;
+}
+
+/* _glmHash: FNV-1a hash of a name
+ */
+static GLuint
+_glmHash(const char* name)
+{
+  GLuint hash = 2166136261u;
+
+  while (*name) {
+    hash ^= (unsigned char)*name++;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+/* _glmHashGroups: rebuild the group hash table with numbuckets buckets
+ *
+ * model      - properly initialized GLMmodel structure
+ * numbuckets - power of two
+ */
+static GLvoid
+_glmHashGroups(GLMmodel* model, GLuint numbuckets)
+{
+  GLMgroup* group;
+  GLuint    bucket;
+
+  _glmFree(model, model->groupbuckets);
+  model->groupbuckets = (GLMgroup**)_glmAlloc(model, sizeof(GLMgroup*) * numbuckets);
+  memset(model->groupbuckets, 0, sizeof(GLMgroup*) * numbuckets);
+  model->numgroupbuckets = numbuckets;
+
+  for (group = model->groups; group; group = group->next) {
+    bucket = _glmHash(group->name) & (numbuckets - 1);
+    group->hashnext = model->groupbuckets[bucket];
+    model->groupbuckets[bucket] = group;
+  }
+}
+
+/* _glmHashMaterials: rebuild the material hash table after the
+ * materials were read.  Open addressing, a slot holds the material
+ * index + 1.  If a name is used twice, the first material wins.
+ *
+ * model - properly initialized GLMmodel structure
+ */
+static GLvoid
+_glmHashMaterials(GLMmodel* model)
+{
+  GLuint numbuckets, bucket, i;
+
+  numbuckets = 16;
+  while (numbuckets < 2 * model->nummaterials)
+    numbuckets *= 2;
+
+  _glmFree(model, model->materialbuckets);
+  model->materialbuckets = (GLuint*)_glmAlloc(model, sizeof(GLuint) * numbuckets);
+  memset(model->materialbuckets, 0, sizeof(GLuint) * numbuckets);
+  model->nummaterialbuckets = numbuckets;
+
+  for (i = 0; i < model->nummaterials; i++) {
+    if (!model->materials[i].name)
+      continue;
+    bucket = _glmHash(model->materials[i].name) & (numbuckets - 1);
+    while (model->materialbuckets[bucket] &&
+	   strcmp(model->materials[model->materialbuckets[bucket] - 1].name,
+		  model->materials[i].name))
+      bucket = (bucket + 1) & (numbuckets - 1);
+    if (!model->materialbuckets[bucket])
+      model->materialbuckets[bucket] = i + 1;
+  }
+}
+
 /* _glmFindGroup: Find a group in the model
  */
 GLMgroup*
@@ -183,11 +598,14 @@ _glmFindGroup(GLMmodel* model, char* name)
 
   assert(model);
 
-  group = model->groups;
+  if (!model->numgroupbuckets)
+    return NULL;
+
+  group = model->groupbuckets[_glmHash(name) & (model->numgroupbuckets - 1)];
   while(group) {
     if (!strcmp(name, group->name))
       break;
-    group = group->next;
+    group = group->hashnext;
   }
 
   return group;
@@ -199,43 +617,54 @@ GLMgroup*
 _glmAddGroup(GLMmodel* model, char* name)
 {
   GLMgroup* group;
+  GLuint    bucket;
 
   group = _glmFindGroup(model, name);
   if (!group) {
-    group = (GLMgroup*)malloc(sizeof(GLMgroup));
-    group->name = strdup(name);
+    group = (GLMgroup*)_glmAlloc(model, sizeof(GLMgroup));
+    group->name = _glmStrdup(model, name);
     group->material = 0;
     group->numtriangles = 0;
     group->triangles = NULL;
     group->next = model->groups;
     model->groups = group;
     model->numgroups++;
+
+    /* keep the chains short, Photoscan exports have thousands of groups */
+    if (model->numgroups > model->numgroupbuckets) {
+      _glmHashGroups(model, model->numgroupbuckets ? 2 * model->numgroupbuckets : 64);
+    } else {
+      bucket = _glmHash(name) & (model->numgroupbuckets - 1);
+      group->hashnext = model->groupbuckets[bucket];
+      model->groupbuckets[bucket] = group;
+    }
   }
 
   return group;
 }
 
-/* _glmFindGroup: Find a material in the model
+/* _glmFindMaterial: Find a material in the model
  */
 GLuint
 _glmFindMaterial(GLMmodel* model, char* name)
 {
-  GLuint i;
-
-  for (i = 0; i < model->nummaterials; i++) {
-    if (!strcmp(model->materials[i].name, name))
-      goto found;
+  GLuint bucket;
+
+  if (model->nummaterialbuckets) {
+    bucket = _glmHash(name) & (model->nummaterialbuckets - 1);
+    while (model->materialbuckets[bucket]) {
+      GLuint i = model->materialbuckets[bucket] - 1;
+      if (!strcmp(model->materials[i].name, name))
+	return i;
+      bucket = (bucket + 1) & (model->nummaterialbuckets - 1);
+    }
   }
 
   /* didn't find the name, so set it as the default material */
   printf("_glmFindMaterial():  can't find material \"%s\".\n", name);
-  i = 0;
-
-found:
-  return i;
+  return 0;
 }
 
-
 /* _glmDirName: return the directory given a path
  *
  * path - filesystem path
@@ -312,7 +741,7 @@ _glmReadMTL(GLMmodel* model, char* name)
   rewind(file);
 
   /* allocate memory for the materials */
-  model->materials = (GLMmaterial*)malloc(sizeof(GLMmaterial) * nummaterials);
+  model->materials = (GLMmaterial*)_glmAlloc(model, sizeof(GLMmaterial) * nummaterials);
   model->nummaterials = nummaterials;
 
   /* set the default material */
@@ -332,7 +761,7 @@ _glmReadMTL(GLMmodel* model, char* name)
     model->materials[i].specular[2] = 0.0f;
     model->materials[i].specular[3] = 1.0f;
   }
-  model->materials[0].name = strdup("default");
+  model->materials[0].name = _glmStrdup(model, "default");
 
   /* now, read in the data */
   nummaterials = 0;
@@ -346,7 +775,7 @@ _glmReadMTL(GLMmodel* model, char* name)
       fgets(buf, sizeof(buf), file);
       sscanf(buf, "%s %s", buf, buf);
       nummaterials++;
-      model->materials[nummaterials].name = strdup(buf);
+      model->materials[nummaterials].name = _glmStrdup(model, buf);
       break;
     case 'N':
       fscanf(file, "%f", &model->materials[nummaterials].shininess);
@@ -386,6 +815,10 @@ _glmReadMTL(GLMmodel* model, char* name)
       break;
     }
   }
+
+  fclose(file);
+
+  _glmHashMaterials(model);
 }
 
 /* _glmWriteMTL: write a wavefront material library file
@@ -499,7 +932,7 @@ _glmFirstPass(GLMmodel* model, FILE* file)
     case 'm':
       fgets(buf, sizeof(buf), file);
       sscanf(buf, "%s %s", buf, buf);
-      model->mtllibname = strdup(buf);
+      model->mtllibname = _glmStrdup(model, buf);
       _glmReadMTL(model, buf);
       break;
     case 'u':
@@ -587,7 +1020,7 @@ _glmFirstPass(GLMmodel* model, FILE* file)
   /* allocate memory for the triangles in each group */
   group = model->groups;
   while(group) {
-    group->triangles = (GLuint*)malloc(sizeof(GLuint) * group->numtriangles);
+    group->triangles = (GLuint*)_glmAlloc(model, sizeof(GLuint) * group->numtriangles);
     group->numtriangles = 0;
     group = group->next;
   }
@@ -799,6 +1232,682 @@ GLuint    numvertices;		/* number of vertices in model */
 }
 
 
+/* _glmNewModel: allocate an empty model for the given file
+ *
+ * filename - name of the file the model is read from
+ */
+static GLMmodel*
+_glmNewModel(char* filename)
+{
+  GLMmodel* model;
+
+  model = (GLMmodel*)malloc(sizeof(GLMmodel));
+  memset(&model->arena, 0, sizeof(GLMarena));
+  model->pathname      = _glmStrdup(model, filename);
+  model->mtllibname    = NULL;
+  model->numvertices   = 0;
+  model->vertices      = NULL;
+  model->numnormals    = 0;
+  model->normals       = NULL;
+  model->numtexcoords  = 0;
+  model->texcoords     = NULL;
+  model->numfacetnorms = 0;
+  model->facetnorms    = NULL;
+  model->numtriangles  = 0;
+  model->triangles     = NULL;
+  model->nummaterials  = 0;
+  model->materials     = NULL;
+  model->numgroups     = 0;
+  model->groups        = NULL;
+  model->numgroupbuckets    = 0;
+  model->groupbuckets       = NULL;
+  model->nummaterialbuckets = 0;
+  model->materialbuckets    = NULL;
+  model->position[0]   = 0.0;
+  model->position[1]   = 0.0;
+  model->position[2]   = 0.0;
+
+  return model;
+}
+
+/* powers of ten used by _glmParseFloat */
+static const double _glmPow10[] = {
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10,
+  1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/* _glmSkipSpace: skip blanks (but not line ends) */
+static inline const char*
+_glmSkipSpace(const char* p, const char* end)
+{
+  while (p < end && (*p == ' ' || *p == '\t'))
+    p++;
+  return p;
+}
+
+/* _glmSkipLine: skip to the first character of the next line */
+static inline const char*
+_glmSkipLine(const char* p, const char* end)
+{
+  while (p < end && *p != '\n')
+    p++;
+  return p < end ? p + 1 : end;
+}
+
+/* _glmParseFloat: parse a decimal floating point number such as
+ * "-0.701434" or "1.5e-3" without going through the C locale.
+ * Returns a pointer past the number, or p itself if there is none.
+ *
+ * p   - first character of the number (blanks are skipped)
+ * end - end of the buffer
+ * f   - receives the value
+ */
+static const char*
+_glmParseFloat(const char* p, const char* end, GLfloat* f)
+{
+  const char* start;
+  unsigned long long mantissa = 0;
+  int       digits = 0;
+  int       exponent = 0;
+  int       negative = 0;
+  double    value;
+
+  p = _glmSkipSpace(p, end);
+  start = p;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = (*p == '-');
+    p++;
+  }
+  /* integer part; digits beyond what fits into the mantissa only
+     shift the exponent */
+  while (p < end && *p >= '0' && *p <= '9') {
+    if (digits < 19) {
+      mantissa = mantissa * 10 + (*p - '0');
+      if (mantissa) digits++;
+    } else {
+      exponent++;
+    }
+    p++;
+  }
+  /* fractional part */
+  if (p < end && *p == '.') {
+    p++;
+    while (p < end && *p >= '0' && *p <= '9') {
+      if (digits < 19) {
+        mantissa = mantissa * 10 + (*p - '0');
+        if (mantissa) digits++;
+        exponent--;
+      }
+      p++;
+    }
+  }
+  if (p == start || (p == start + 1 && (*start == '-' || *start == '+')))
+    return start;
+  /* exponent */
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    const char* q = p + 1;
+    int expnegative = 0;
+    int e = 0;
+    if (q < end && (*q == '-' || *q == '+')) {
+      expnegative = (*q == '-');
+      q++;
+    }
+    if (q < end && *q >= '0' && *q <= '9') {
+      while (q < end && *q >= '0' && *q <= '9') {
+        if (e < 10000) e = e * 10 + (*q - '0');
+        q++;
+      }
+      exponent += expnegative ? -e : e;
+      p = q;
+    }
+  }
+
+  value = (double)mantissa;
+  if (exponent < 0) {
+    while (exponent < -22) {
+      value /= 1e22;
+      exponent += 22;
+    }
+    value /= _glmPow10[-exponent];
+  } else if (exponent > 0) {
+    while (exponent > 22) {
+      value *= 1e22;
+      exponent -= 22;
+    }
+    value *= _glmPow10[exponent];
+  }
+  *f = (GLfloat)(negative ? -value : value);
+  return p;
+}
+
+/* _glmParseIndex: parse a (possibly negative, i.e. relative) OBJ index
+ * and turn it into an absolute 1-based index.  Returns a pointer past
+ * the number, or p itself if there is none.
+ *
+ * p     - first character of the index
+ * end   - end of the buffer
+ * count - number of elements read so far (for relative indices)
+ * index - receives the index
+ */
+static inline const char*
+_glmParseIndex(const char* p, const char* end, GLuint count, GLuint* index)
+{
+  const char* start = p;
+  GLuint value = 0;
+  int    negative = 0;
+
+  if (p < end && *p == '-') {
+    negative = 1;
+    p++;
+  }
+  if (p == end || *p < '0' || *p > '9')
+    return start;
+  while (p < end && *p >= '0' && *p <= '9') {
+    value = value * 10 + (*p - '0');
+    p++;
+  }
+  *index = negative ? count + 1 - value : value;
+  return p;
+}
+
+/* _glmParseName: copy the first blank separated token of the rest of
+ * the line into buf (truncated to size - 1 characters).  Returns the
+ * length of the token.
+ */
+static GLuint
+_glmParseName(const char* p, const char* end, char* buf, GLuint size)
+{
+  GLuint length = 0;
+
+  p = _glmSkipSpace(p, end);
+  while (p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') {
+    if (length + 1 < size)
+      buf[length++] = *p;
+    p++;
+  }
+  buf[length] = '\0';
+  return length;
+}
+
+/* _glmIsKeyword: check that the line starts with the given keyword
+ * followed by a blank.
+ */
+static inline GLboolean
+_glmIsKeyword(const char* p, const char* end, const char* keyword)
+{
+  while (*keyword) {
+    if (p == end || *p != *keyword)
+      return GL_FALSE;
+    p++;
+    keyword++;
+  }
+  return (p < end && (*p == ' ' || *p == '\t')) ? GL_TRUE : GL_FALSE;
+}
+
+/* _GLMevent: a line that changes the group/material state (g, usemtl,
+ * mtllib), recorded while a chunk is parsed and replayed in file order
+ * when the chunks are stitched together.
+ */
+typedef struct {
+  char   type;				/* 'g', 'u' (usemtl) or 'm' (mtllib) */
+  string name;				/* group/material/library name */
+  GLuint firsttriangle;			/* chunk index of the first triangle after it */
+  GLMgroup* group;			/* state after the line (set by the stitcher) */
+  GLuint material;
+} _GLMevent;
+
+/* _GLMrelative: a negative (relative) index that has to be rebased
+ * once the number of elements in the preceding chunks is known.
+ */
+typedef struct {
+  GLuint triangle;			/* chunk index of the triangle */
+  GLuint corner;			/* 0..2 */
+  char   type;				/* 'v', 't' or 'n' */
+} _GLMrelative;
+
+/* _GLMchunk: a range of whole lines of an OBJ file and everything
+ * parsed from it.  Vertex attributes are packed (no unused index 0),
+ * face indices are as written in the file.
+ */
+typedef struct {
+  const char* begin;
+  const char* end;
+  vector<GLfloat>      vertices;
+  vector<GLfloat>      normals;
+  vector<GLfloat>      texcoords;
+  vector<GLMtriangle>  triangles;
+  vector<_GLMevent>    events;
+  vector<_GLMrelative> relatives;
+  GLuint vertexoffset;			/* elements in the chunks before this one */
+  GLuint normaloffset;
+  GLuint texcoordoffset;
+  GLuint triangleoffset;
+} _GLMchunk;
+
+/* _glmParseChunk: parse the lines of one chunk.  Does not touch the
+ * model, so any number of chunks can be parsed at the same time.
+ *
+ * chunk - chunk with begin/end set
+ */
+static GLvoid
+_glmParseChunk(_GLMchunk* chunk)
+{
+  const char* p   = chunk->begin;
+  const char* end = chunk->end;
+  char        buf[1280];
+
+  /* rough guesses so that the vectors grow only a couple of times */
+  chunk->vertices.reserve((end - p) / 32);
+  chunk->triangles.reserve((end - p) / 96);
+
+  while (p < end) {
+    p = _glmSkipSpace(p, end);
+    if (p == end)
+      break;
+
+    switch (*p) {
+    case 'v':				/* v, vn, vt */
+      if (p + 1 < end && (p[1] == ' ' || p[1] == '\t')) {
+	GLfloat v[3] = { 0.0f, 0.0f, 0.0f };
+	p = _glmParseFloat(p + 1, end, &v[X]);
+	p = _glmParseFloat(p, end, &v[Y]);
+	p = _glmParseFloat(p, end, &v[Z]);
+	chunk->vertices.insert(chunk->vertices.end(), v, v + 3);
+      } else if (p + 1 < end && p[1] == 'n') {
+	GLfloat n[3] = { 0.0f, 0.0f, 0.0f };
+	p = _glmParseFloat(p + 2, end, &n[X]);
+	p = _glmParseFloat(p, end, &n[Y]);
+	p = _glmParseFloat(p, end, &n[Z]);
+	chunk->normals.insert(chunk->normals.end(), n, n + 3);
+      } else if (p + 1 < end && p[1] == 't') {
+	GLfloat t[2] = { 0.0f, 0.0f };
+	p = _glmParseFloat(p + 2, end, &t[X]);
+	p = _glmParseFloat(p, end, &t[Y]);
+	chunk->texcoords.insert(chunk->texcoords.end(), t, t + 2);
+      }
+      break;
+
+    case 'f':				/* face */
+      if (p + 1 < end && (p[1] == ' ' || p[1] == '\t')) {
+	GLMtriangle  tri;
+	_GLMrelative rel[9];		/* up to 3 per corner */
+	GLuint       numrel = 0;
+	GLuint       corners = 0;
+	GLuint       k;
+
+	p++;
+	for (;;) {
+	  GLuint vi = 0, ti = 0, ni = 0;
+	  GLboolean vr = GL_FALSE, tr = GL_FALSE, nr = GL_FALSE;
+	  GLuint c;
+	  const char* q;
+
+	  /* can be one of %d, %d//%d, %d/%d, %d/%d/%d; relative indices
+	     are resolved against this chunk and rebased later */
+	  p = _glmSkipSpace(p, end);
+	  vr = (p < end && *p == '-');
+	  q = _glmParseIndex(p, end, (GLuint)chunk->vertices.size() / 3, &vi);
+	  if (q == p)
+	    break;
+	  p = q;
+	  if (p < end && *p == '/') {
+	    p++;
+	    tr = (p < end && *p == '-');
+	    p = _glmParseIndex(p, end, (GLuint)chunk->texcoords.size() / 2, &ti);
+	    if (p < end && *p == '/') {
+	      p++;
+	      nr = (p < end && *p == '-');
+	      p = _glmParseIndex(p, end, (GLuint)chunk->normals.size() / 3, &ni);
+	    }
+	  }
+
+	  if (corners < 3) {
+	    c = corners;
+	  } else {
+	    /* triangle fan for polygons: (first, previous last, new) */
+	    tri.vindices[1] = tri.vindices[2];
+	    tri.tindices[1] = tri.tindices[2];
+	    tri.nindices[1] = tri.nindices[2];
+	    for (k = 0; k < numrel; k++) {
+	      if (rel[k].corner == 1) {
+		rel[k] = rel[--numrel];
+		k--;
+	      }
+	    }
+	    for (k = 0; k < numrel; k++) {
+	      if (rel[k].corner == 2)
+		rel[k].corner = 1;
+	    }
+	    c = 2;
+	  }
+	  tri.vindices[c] = vi;
+	  tri.tindices[c] = ti;
+	  tri.nindices[c] = ni;
+	  if (vr) { rel[numrel].corner = c; rel[numrel].type = 'v'; numrel++; }
+	  if (tr) { rel[numrel].corner = c; rel[numrel].type = 't'; numrel++; }
+	  if (nr) { rel[numrel].corner = c; rel[numrel].type = 'n'; numrel++; }
+	  corners++;
+
+	  if (corners >= 3) {
+	    tri.findex = 0;
+	    tri.material = 0;
+	    for (k = 0; k < numrel; k++) {
+	      rel[k].triangle = (GLuint)chunk->triangles.size();
+	      chunk->relatives.push_back(rel[k]);
+	    }
+	    chunk->triangles.push_back(tri);
+	  }
+	}
+      }
+      break;
+
+    case 'u':				/* usemtl */
+    case 'm':				/* mtllib */
+    case 'g':				/* group */
+      if (_glmIsKeyword(p, end, "usemtl") || _glmIsKeyword(p, end, "mtllib") ||
+	  (*p == 'g' && _glmIsKeyword(p, end, "g"))) {
+	_GLMevent event;
+	event.type = *p;
+	_glmParseName(p + (*p == 'g' ? 1 : 6), end, buf, sizeof(buf));
+	event.name = buf;
+	event.firsttriangle = (GLuint)chunk->triangles.size();
+	event.group = NULL;
+	event.material = 0;
+	chunk->events.push_back(event);
+      }
+      break;
+
+    default:
+      break;
+    }
+
+    /* eat up rest of line */
+    p = _glmSkipLine(p, end);
+  }
+}
+
+/* _glmForEachChunk: run func on every chunk, each on its own thread
+ * if there is more than one.
+ */
+template <typename Func>
+static GLvoid
+_glmForEachChunk(vector<_GLMchunk>& chunks, Func func)
+{
+  vector<thread> threads;
+  size_t i;
+
+  if (chunks.size() == 1) {
+    func(&chunks[0]);
+    return;
+  }
+  for (i = 0; i < chunks.size(); i++)
+    threads.push_back(thread(func, &chunks[i]));
+  for (i = 0; i < threads.size(); i++)
+    threads[i].join();
+}
+
+/* _glmStitchChunks: build the model from parsed chunks.  The
+ * group/material lines are replayed in file order (so groups, dummy
+ * groups for usemtl and materials come out exactly as with
+ * _glmFirstPass/_glmSecondPass), then the attribute and triangle
+ * arrays of all chunks are copied into the model in parallel.
+ *
+ * model  - properly initialized GLMmodel structure
+ * chunks - parsed chunks in file order
+ */
+static GLvoid
+_glmStitchChunks(GLMmodel* model, vector<_GLMchunk>& chunks)
+{
+  GLMgroup* group;			/* current group */
+  GLuint    material;			/* current material */
+  GLuint    dummygroups = 0;
+  GLuint    numvertices, numnormals, numtexcoords, numtriangles;
+  size_t    c, e;
+  GLuint    i;
+  char      mbuf[2560];
+
+  /* make a default group */
+  group = _glmAddGroup(model, (char*)"default");
+  material = 0;
+
+  numvertices = numnormals = numtexcoords = numtriangles = 0;
+  for (c = 0; c < chunks.size(); c++) {
+    _GLMchunk* chunk = &chunks[c];
+    GLuint first = 0;
+
+    chunk->vertexoffset   = numvertices;
+    chunk->normaloffset   = numnormals;
+    chunk->texcoordoffset = numtexcoords;
+    chunk->triangleoffset = numtriangles;
+    numvertices  += (GLuint)chunk->vertices.size() / 3;
+    numnormals   += (GLuint)chunk->normals.size() / 3;
+    numtexcoords += (GLuint)chunk->texcoords.size() / 2;
+    numtriangles += (GLuint)chunk->triangles.size();
+
+    /* the triangles before the first event keep the state the
+       previous chunk ended with, it is stored in a leading event */
+    _GLMevent lead;
+    lead.type = '\0';
+    lead.firsttriangle = 0;
+    lead.group = group;
+    lead.material = material;
+    chunk->events.insert(chunk->events.begin(), lead);
+
+    for (e = 1; e < chunk->events.size(); e++) {
+      _GLMevent* event = &chunk->events[e];
+      char* name = (char*)event->name.c_str();
+
+      group->numtriangles += event->firsttriangle - first;
+      first = event->firsttriangle;
+
+      switch (event->type) {
+      case 'u':
+	sprintf(mbuf, "dummygroup_%d", dummygroups); dummygroups++;
+	group = _glmAddGroup(model, mbuf);
+	group->material = material = _glmFindMaterial(model, name);
+	break;
+      case 'm':
+	model->mtllibname = _glmStrdup(model, name);
+	_glmReadMTL(model, name);
+	break;
+      case 'g':
+	group = _glmAddGroup(model, name[0] ? name : (char*)"default");
+	group->material = material;
+	break;
+      }
+      event->group = group;
+      event->material = material;
+    }
+    group->numtriangles += (GLuint)chunk->triangles.size() - first;
+  }
+
+  /* set the stats in the model structure and allocate memory */
+  model->numvertices  = numvertices;
+  model->numnormals   = numnormals;
+  model->numtexcoords = numtexcoords;
+  model->numtriangles = numtriangles;
+  model->vertices = (GLfloat*)_glmAlloc(model, sizeof(GLfloat) *
+					 3 * (model->numvertices + 1));
+  model->triangles = (GLMtriangle*)_glmAlloc(model, sizeof(GLMtriangle) *
+					      model->numtriangles);
+  if (model->numnormals) {
+    model->normals = (GLfloat*)_glmAlloc(model, sizeof(GLfloat) *
+					  3 * (model->numnormals + 1));
+  }
+  if (model->numtexcoords) {
+    model->texcoords = (GLfloat*)_glmAlloc(model, sizeof(GLfloat) *
+					    2 * (model->numtexcoords + 1));
+  }
+  for (group = model->groups; group; group = group->next) {
+    group->triangles = (GLuint*)_glmAlloc(model, sizeof(GLuint) * group->numtriangles);
+    group->numtriangles = 0;
+  }
+
+  /* hand out the triangle ranges to the groups in file order */
+  for (c = 0; c < chunks.size(); c++) {
+    _GLMchunk* chunk = &chunks[c];
+    for (e = 0; e < chunk->events.size(); e++) {
+      GLuint first = chunk->events[e].firsttriangle;
+      GLuint last  = e + 1 < chunk->events.size() ?
+	chunk->events[e + 1].firsttriangle : (GLuint)chunk->triangles.size();
+      group = chunk->events[e].group;
+      for (i = first; i < last; i++)
+	group->triangles[group->numtriangles++] = chunk->triangleoffset + i;
+    }
+  }
+
+  /* copy the data (index 0 of the attribute arrays is unused) */
+  _glmForEachChunk(chunks, [model](_GLMchunk* chunk) {
+    GLMtriangle* triangles = model->triangles + chunk->triangleoffset;
+    size_t e;
+    GLuint i;
+
+    if (!chunk->vertices.empty())
+      memcpy(&model->vertices[3 * (chunk->vertexoffset + 1)],
+	     chunk->vertices.data(), sizeof(GLfloat) * chunk->vertices.size());
+    if (!chunk->normals.empty())
+      memcpy(&model->normals[3 * (chunk->normaloffset + 1)],
+	     chunk->normals.data(), sizeof(GLfloat) * chunk->normals.size());
+    if (!chunk->texcoords.empty())
+      memcpy(&model->texcoords[2 * (chunk->texcoordoffset + 1)],
+	     chunk->texcoords.data(), sizeof(GLfloat) * chunk->texcoords.size());
+    if (!chunk->triangles.empty())
+      memcpy(triangles, chunk->triangles.data(),
+	     sizeof(GLMtriangle) * chunk->triangles.size());
+
+    for (e = 0; e < chunk->events.size(); e++) {
+      GLuint first = chunk->events[e].firsttriangle;
+      GLuint last  = e + 1 < chunk->events.size() ?
+	chunk->events[e + 1].firsttriangle : (GLuint)chunk->triangles.size();
+      for (i = first; i < last; i++)
+	triangles[i].material = chunk->events[e].material;
+    }
+    for (i = 0; i < chunk->relatives.size(); i++) {
+      _GLMrelative* rel = &chunk->relatives[i];
+      GLMtriangle*  tri = &triangles[rel->triangle];
+      if (rel->type == 'v')
+	tri->vindices[rel->corner] += chunk->vertexoffset;
+      else if (rel->type == 't')
+	tri->tindices[rel->corner] += chunk->texcoordoffset;
+      else
+	tri->nindices[rel->corner] += chunk->normaloffset;
+    }
+  });
+}
+
+/* _glmChunkedPass: read a whole Wavefront OBJ file from memory.  The
+ * file is split into numthreads ranges of whole lines which are
+ * parsed at the same time and then stitched together.  Produces the
+ * same model (group list, dummy groups for usemtl, triangle fans for
+ * polygons) as _glmFirstPass/_glmSecondPass.
+ *
+ * model      - properly initialized GLMmodel structure
+ * data       - contents of the file
+ * size       - size of the file in bytes
+ * numthreads - number of chunks/threads (at least 1)
+ */
+static GLvoid
+_glmChunkedPass(GLMmodel* model, const char* data, size_t size, GLuint numthreads)
+{
+  vector<_GLMchunk> chunks;
+  const char* begin = data;
+  const char* end   = data + size;
+  size_t buffers = 0;
+  GLuint i;
+
+  /* don't bother splitting small files */
+  if (size < numthreads * (size_t)(1 << 16))
+    numthreads = (GLuint)(size >> 16) + 1;
+
+  /* split at line boundaries */
+  chunks.resize(numthreads);
+  for (i = 0; i < numthreads; i++) {
+    const char* split = i + 1 < numthreads ? data + size / numthreads * (i + 1) : end;
+    if (split < begin)
+      split = begin;
+    if (split < end)
+      split = _glmSkipLine(split, end);
+    chunks[i].begin = begin;
+    chunks[i].end   = split;
+    begin = split;
+  }
+
+  _glmForEachChunk(chunks, _glmParseChunk);
+  _glmStitchChunks(model, chunks);
+
+  /* the chunks are alive until here, next to the model arrays */
+  for (i = 0; i < numthreads; i++) {
+    buffers += chunks[i].vertices.capacity() * sizeof(GLfloat);
+    buffers += chunks[i].normals.capacity() * sizeof(GLfloat);
+    buffers += chunks[i].texcoords.capacity() * sizeof(GLfloat);
+    buffers += chunks[i].triangles.capacity() * sizeof(GLMtriangle);
+    buffers += chunks[i].events.capacity() * sizeof(_GLMevent);
+    buffers += chunks[i].relatives.capacity() * sizeof(_GLMrelative);
+  }
+  _glmTrackPeak(model, buffers);
+}
+
+/* _glmCompareModels: check that two models read from the same file
+ * are identical (counts, groups, materials and all triangle indices
+ * that are used).  Returns GL_TRUE if they are.
+ *
+ * a, b     - initialized GLMmodel structures
+ * maxerror - receives the largest difference of any vertex attribute
+ */
+static GLboolean
+_glmCompareModels(GLMmodel* a, GLMmodel* b, GLfloat* maxerror)
+{
+  GLMgroup* agroup;
+  GLMgroup* bgroup;
+  GLuint    i, k;
+
+  *maxerror = 0.0f;
+  if (a->numvertices != b->numvertices ||
+      a->numnormals != b->numnormals ||
+      a->numtexcoords != b->numtexcoords ||
+      a->numtriangles != b->numtriangles ||
+      a->numgroups != b->numgroups ||
+      a->nummaterials != b->nummaterials)
+    return GL_FALSE;
+
+  for (i = 3; i < 3 * (a->numvertices + 1); i++)
+    *maxerror = _glmMax(*maxerror, _glmAbs(a->vertices[i] - b->vertices[i]));
+  for (i = 3; i < 3 * (a->numnormals + 1); i++)
+    *maxerror = _glmMax(*maxerror, _glmAbs(a->normals[i] - b->normals[i]));
+  for (i = 2; i < 2 * (a->numtexcoords + 1); i++)
+    *maxerror = _glmMax(*maxerror, _glmAbs(a->texcoords[i] - b->texcoords[i]));
+
+  for (i = 0; i < a->numtriangles; i++) {
+    if (a->triangles[i].material != b->triangles[i].material)
+      return GL_FALSE;
+    for (k = 0; k < 3; k++) {
+      if (a->triangles[i].vindices[k] != b->triangles[i].vindices[k])
+	return GL_FALSE;
+      if (a->numnormals &&
+	  a->triangles[i].nindices[k] != b->triangles[i].nindices[k])
+	return GL_FALSE;
+      if (a->numtexcoords &&
+	  a->triangles[i].tindices[k] != b->triangles[i].tindices[k])
+	return GL_FALSE;
+    }
+  }
+
+  for (agroup = a->groups, bgroup = b->groups; agroup && bgroup;
+       agroup = agroup->next, bgroup = bgroup->next) {
+    if (strcmp(agroup->name, bgroup->name) ||
+	agroup->material != bgroup->material ||
+	agroup->numtriangles != bgroup->numtriangles ||
+	memcmp(agroup->triangles, bgroup->triangles,
+	       sizeof(GLuint) * agroup->numtriangles))
+      return GL_FALSE;
+  }
+  for (i = 0; i < a->nummaterials; i++) {
+    if (strcmp(a->materials[i].name, b->materials[i].name))
+      return GL_FALSE;
+  }
+
+  return GL_TRUE;
+}
 
 
 /* public functions */
@@ -1014,12 +2123,12 @@ glmFacetNormals(GLMmodel* model)
 
   /* clobber any old facetnormals */
   if (model->facetnorms)
-    free(model->facetnorms);
+    _glmFree(model, model->facetnorms);
 
   /* allocate memory for the new facet normals */
   model->numfacetnorms = model->numtriangles;
-  model->facetnorms = (GLfloat*)malloc(sizeof(GLfloat) *
-				       3 * (model->numfacetnorms + 1));
+  model->facetnorms = (GLfloat*)_glmAlloc(model, sizeof(GLfloat) *
+					   3 * (model->numfacetnorms + 1));
 
   for (i = 0; i < model->numtriangles; i++) {
     model->triangles[i].findex = i+1;
@@ -1056,20 +2165,26 @@ glmFacetNormals(GLMmodel* model)
  * the facet normal.  This tends to preserve hard edges.  The angle to
  * use depends on the model, but 90 degrees is usually a good start.
  *
- * model - initialized GLMmodel structure
- * angle - maximum angle (in degrees) to smooth across
+ * The triangle lists are stored in compressed rows (built with a
+ * counting sort) and walked from the last triangle to the first, the
+ * order of the linked lists this function used to build, so the
+ * normals and their numbering are the same as before.  Vertices are
+ * processed on numthreads threads: a first pass counts the normals
+ * of every vertex, a second one writes them at their prefix sum.
+ *
+ * model      - initialized GLMmodel structure
+ * angle      - maximum angle (in degrees) to smooth across
+ * numthreads - number of threads, 0 = one per core
  */
 GLvoid
-glmVertexNormals(GLMmodel* model, GLfloat angle)
+glmVertexNormals(GLMmodel* model, GLfloat angle, GLuint numthreads)
 {
-  GLMnode*  node;
-  GLMnode*  tail;
-  GLMnode** members;
-  GLfloat*  normals;
-  GLuint    numnormals;
-  GLfloat   average[3];
-  GLfloat   dot, cos_angle;
-  GLuint    i, avg;
+  vector<GLuint> offsets;		/* vertex i is in triangles[offsets[i]] .. [offsets[i+1]-1] */
+  vector<GLuint> triangles;
+  vector<GLuint> first;			/* index of the first normal of each vertex */
+  GLfloat        cos_angle;
+  GLuint         numlonely = 0;
+  GLuint         i, k;
 
   assert(model);
   assert(model->facetnorms);
@@ -1079,133 +2194,105 @@ glmVertexNormals(GLMmodel* model, GLfloat angle)
 
   /* nuke any previous normals */
   if (model->normals)
-    free(model->normals);
+    _glmFree(model, model->normals);
 
-  /* allocate space for new normals */
-  model->numnormals = model->numtriangles * 3; /* 3 normals per triangle */
-  model->normals = (GLfloat*)malloc(sizeof(GLfloat)* 3* (model->numnormals+1));
-
-  /* allocate a structure that will hold a linked list of triangle
-     indices for each vertex */
-  members = (GLMnode**)malloc(sizeof(GLMnode*) * (model->numvertices + 1));
+  /* vertex -> triangle adjacency, triangles in ascending order */
+  offsets.assign(model->numvertices + 2, 0);
+  for (i = 0; i < model->numtriangles; i++)
+    for (k = 0; k < 3; k++)
+      offsets[T(i).vindices[k] + 1]++;
   for (i = 1; i <= model->numvertices; i++)
-    members[i] = NULL;
-  
-  /* for every triangle, create a node for each vertex in it */
-  for (i = 0; i < model->numtriangles; i++) {
-    node = (GLMnode*)malloc(sizeof(GLMnode));
-    node->index = i;
-    node->next  = members[T(i).vindices[0]];
-    members[T(i).vindices[0]] = node;
-
-    node = (GLMnode*)malloc(sizeof(GLMnode));
-    node->index = i;
-    node->next  = members[T(i).vindices[1]];
-    members[T(i).vindices[1]] = node;
-
-    node = (GLMnode*)malloc(sizeof(GLMnode));
-    node->index = i;
-    node->next  = members[T(i).vindices[2]];
-    members[T(i).vindices[2]] = node;
+    offsets[i + 1] += offsets[i];
+  triangles.resize(offsets[model->numvertices + 1]);
+  {
+    vector<GLuint> fill(offsets.begin(), offsets.end() - 1);
+    for (i = 0; i < model->numtriangles; i++)
+      for (k = 0; k < 3; k++)
+	triangles[fill[T(i).vindices[k]]++] = i;
   }
 
-  /* calculate the average normal for each vertex */
-  numnormals = 1;
-  for (i = 1; i <= model->numvertices; i++) {
-    /* calculate an average normal for this vertex by averaging the
-       facet normal of every triangle this vertex is in */
-    node = members[i];
-    if (!node)
-      fprintf(stderr, "glmVertexNormals(): vertex w/o a triangle\n");
-    average[0] = 0.0; average[1] = 0.0; average[2] = 0.0;
-    avg = 0;
-    while (node) {
-      /* only average if the dot product of the angle between the two
-         facet normals is greater than the cosine of the threshold
-         angle -- or, said another way, the angle between the two
-         facet normals is less than (or equal to) the threshold angle */
-      dot = _glmDot(&model->facetnorms[3 * T(node->index).findex],
- 		    &model->facetnorms[3 * T(members[i]->index).findex]);
-      if (dot > cos_angle) {
-	node->averaged = GL_TRUE;
-	average[0] += model->facetnorms[3 * T(node->index).findex + 0];
-	average[1] += model->facetnorms[3 * T(node->index).findex + 1];
-	average[2] += model->facetnorms[3 * T(node->index).findex + 2];
-	avg = 1;			/* we averaged at least one normal! */
-      } else {
-	node->averaged = GL_FALSE;
+  /* averaged(v, e): whether the facet normal of triangle entry e of
+     vertex v goes into its average normal, i.e. whether the angle to
+     the facet normal of the first (= last added) triangle is below
+     the threshold angle */
+  auto facet = [model](GLuint t) { return &model->facetnorms[3 * T(t).findex]; };
+  auto averaged = [&](GLuint v, GLuint e) {
+    return _glmDot(facet(triangles[e]), facet(triangles[offsets[v + 1] - 1])) > cos_angle;
+  };
+
+  /* pass 1: number of normals of each vertex */
+  first.assign(model->numvertices + 2, 0);
+  _glmParallelFor(model->numvertices, numthreads, [&](GLuint lo, GLuint hi) {
+    GLuint v, e, count, avg;
+    for (v = lo + 1; v <= hi; v++) {
+      count = 0;
+      avg = 0;
+      for (e = offsets[v]; e < offsets[v + 1]; e++) {
+	if (averaged(v, e))
+	  avg = 1;
+	else
+	  count++;
       }
-      node = node->next;
-    }
-
-    if (avg) {
-      /* normalize the averaged normal */
-      _glmNormalize(average);
-
-      /* add the normal to the vertex normals list */
-      model->normals[3 * numnormals + 0] = average[0];
-      model->normals[3 * numnormals + 1] = average[1];
-      model->normals[3 * numnormals + 2] = average[2];
-      avg = numnormals;
-      numnormals++;
+      first[v + 1] = count + avg;
     }
+  });
+  first[1] = 1;
+  for (i = 1; i <= model->numvertices; i++) {
+    first[i + 1] += first[i];
+    if (offsets[i] == offsets[i + 1])
+      numlonely++;
+  }
+  if (numlonely)
+    fprintf(stderr, "glmVertexNormals(): %d vertices w/o a triangle\n", numlonely);
+
+  model->numnormals = first[model->numvertices + 1] - 1;
+  model->normals = (GLfloat*)_glmAlloc(model, sizeof(GLfloat)* 3* (model->numnormals+1));
+
+  /* pass 2: average and write the normals */
+  _glmParallelFor(model->numvertices, numthreads, [&](GLuint lo, GLuint hi) {
+    GLfloat average[3];
+    GLuint  v, e, n, avg, corner;
+    for (v = lo + 1; v <= hi; v++) {
+      average[0] = 0.0; average[1] = 0.0; average[2] = 0.0;
+      avg = 0;
+      for (e = offsets[v + 1]; e-- > offsets[v];) {
+	if (averaged(v, e)) {
+	  average[0] += facet(triangles[e])[0];
+	  average[1] += facet(triangles[e])[1];
+	  average[2] += facet(triangles[e])[2];
+	  avg = 1;			/* we averaged at least one normal! */
+	}
+      }
 
-    /* set the normal of this vertex in each triangle it is in */
-    node = members[i];
-    while (node) {
-      if (node->averaged) {
-	/* if this node was averaged, use the average normal */
-	if (T(node->index).vindices[0] == i)
-	  T(node->index).nindices[0] = avg;
-	else if (T(node->index).vindices[1] == i)
-	  T(node->index).nindices[1] = avg;
-	else if (T(node->index).vindices[2] == i)
-	  T(node->index).nindices[2] = avg;
-      } else {
-	/* if this node wasn't averaged, use the facet normal */
-	model->normals[3 * numnormals + 0] = 
-	  model->facetnorms[3 * T(node->index).findex + 0];
-	model->normals[3 * numnormals + 1] = 
-	  model->facetnorms[3 * T(node->index).findex + 1];
-	model->normals[3 * numnormals + 2] = 
-	  model->facetnorms[3 * T(node->index).findex + 2];
-	if (T(node->index).vindices[0] == i)
-	  T(node->index).nindices[0] = numnormals;
-	else if (T(node->index).vindices[1] == i)
-	  T(node->index).nindices[1] = numnormals;
-	else if (T(node->index).vindices[2] == i)
-	  T(node->index).nindices[2] = numnormals;
-	numnormals++;
+      n = first[v];
+      if (avg) {
+	/* normalize the averaged normal */
+	_glmNormalize(average);
+	model->normals[3 * n + 0] = average[0];
+	model->normals[3 * n + 1] = average[1];
+	model->normals[3 * n + 2] = average[2];
+	avg = n;
+	n++;
       }
-      node = node->next;
-    }
-  }
-  
-  model->numnormals = numnormals - 1;
 
-  /* free the member information */
-  for (i = 1; i <= model->numvertices; i++) {
-    node = members[i];
-    while (node) {
-      tail = node;
-      node = node->next;
-      free(tail);
+      /* set the normal of this vertex in each triangle it is in, only
+	 the first corner that uses this vertex is set */
+      for (e = offsets[v + 1]; e-- > offsets[v];) {
+	GLMtriangle* triangle = &T(triangles[e]);
+	corner = triangle->vindices[0] == v ? 0 : triangle->vindices[1] == v ? 1 : 2;
+	if (averaged(v, e)) {
+	  triangle->nindices[corner] = avg;
+	} else {
+	  /* if this triangle wasn't averaged, use the facet normal */
+	  model->normals[3 * n + 0] = facet(triangles[e])[0];
+	  model->normals[3 * n + 1] = facet(triangles[e])[1];
+	  model->normals[3 * n + 2] = facet(triangles[e])[2];
+	  triangle->nindices[corner] = n;
+	  n++;
+	}
+      }
     }
-  }
-  free(members);
-
-  /* pack the normals array (we previously allocated the maximum
-     number of normals that could possibly be created (numtriangles *
-     3), so get rid of some of them (usually alot unless none of the
-     facet normals were averaged)) */
-  normals = model->normals;
-  model->normals = (GLfloat*)malloc(sizeof(GLfloat)* 3* (model->numnormals+1));
-  for (i = 1; i <= model->numnormals; i++) {
-    model->normals[3 * i + 0] = normals[3 * i + 0];
-    model->normals[3 * i + 1] = normals[3 * i + 1];
-    model->normals[3 * i + 2] = normals[3 * i + 2];
-  }
-  free(normals);
+  });
 
   printf("glmVertexNormals(): %d normals generated\n", model->numnormals);
 }
@@ -1228,9 +2315,9 @@ glmLinearTexture(GLMmodel* model)
   assert(model);
 
   if (model->texcoords)
-    free(model->texcoords);
+    _glmFree(model, model->texcoords);
   model->numtexcoords = model->numvertices;
-  model->texcoords=(GLfloat*)malloc(sizeof(GLfloat)*2*(model->numtexcoords+1));
+  model->texcoords=(GLfloat*)_glmAlloc(model, sizeof(GLfloat)*2*(model->numtexcoords+1));
   
   glmDimensions(model, dimensions);
   scalefactor = 2.0f / 
@@ -1283,9 +2370,9 @@ glmSpheremapTexture(GLMmodel* model)
   assert(model->normals);
 
   if (model->texcoords)
-    free(model->texcoords);
+    _glmFree(model, model->texcoords);
   model->numtexcoords = model->numnormals;
-  model->texcoords=(GLfloat*)malloc(sizeof(GLfloat)*2*(model->numtexcoords+1));
+  model->texcoords=(GLfloat*)_glmAlloc(model, sizeof(GLfloat)*2*(model->numtexcoords+1));
      
   /* do the calculations */
   for (i = 1; i <= model->numnormals; i++) {
@@ -1345,34 +2432,35 @@ glmSpheremapTexture(GLMmodel* model)
 GLvoid
 glmDelete(GLMmodel* model)
 {
-  GLMgroup* group;
-  GLuint i;
+  GLMblock* block;
 
   assert(model);
 
-  if (model->pathname)   free(model->pathname);
-  if (model->mtllibname) free(model->mtllibname);
-  if (model->vertices)   free(model->vertices);
-  if (model->normals)    free(model->normals);
-  if (model->texcoords)  free(model->texcoords);
-  if (model->facetnorms) free(model->facetnorms);
-  if (model->triangles)  free(model->triangles);
-  if (model->materials) {
-    for (i = 0; i < model->nummaterials; i++)
-      free(model->materials[i].name);
-  }
-  free(model->materials);
-  while(model->groups) {
-    group = model->groups;
-    model->groups = model->groups->next;
-    free(group->name);
-    free(group->triangles);
-    free(group);
+  /* everything the model points to lives in its arena */
+  while(model->arena.blocks) {
+    block = model->arena.blocks;
+    model->arena.blocks = block->next;
+    free(block);
   }
 
   free(model);
 }
 
+/* glmPrintMemory: Prints how many allocations the arena of a model
+ * served, in how many blocks, and the bytes used and at peak.
+ *
+ * model - initialized GLMmodel structure
+ */
+GLvoid
+glmPrintMemory(GLMmodel* model)
+{
+  assert(model);
+
+  printf("glmPrintMemory(): %u allocations in %u blocks, %.1f KB used, %.1f KB peak.\n",
+	 model->arena.numallocs, model->arena.numblocks,
+	 model->arena.used / 1024.0, model->arena.peak / 1024.0);
+}
+
 /* glmReadOBJ: Reads a model description from a Wavefront .OBJ file.
  * Returns a pointer to the created object which should be free'd with
  * glmDelete().
@@ -1399,26 +2487,7 @@ glmReadOBJ(char* filename)
 #endif
 
   /* allocate a new model */
-  model = (GLMmodel*)malloc(sizeof(GLMmodel));
-  model->pathname      = strdup(filename);
-  model->mtllibname    = NULL;
-  model->numvertices   = 0;
-  model->vertices      = NULL;
-  model->numnormals    = 0;
-  model->normals       = NULL;
-  model->numtexcoords  = 0;
-  model->texcoords     = NULL;
-  model->numfacetnorms = 0;
-  model->facetnorms    = NULL;
-  model->numtriangles  = 0;
-  model->triangles     = NULL;
-  model->nummaterials  = 0;
-  model->materials     = NULL;
-  model->numgroups     = 0;
-  model->groups        = NULL;
-  model->position[0]   = 0.0;
-  model->position[1]   = 0.0;
-  model->position[2]   = 0.0;
+  model = _glmNewModel(filename);
 
 	//_glmReadMTL( model, "bigguy.mtl" );
   /* make a first pass through the file to get a count of the number
@@ -1426,17 +2495,17 @@ glmReadOBJ(char* filename)
   _glmFirstPass(model, file);
 
   /* allocate memory */
-  model->vertices = (GLfloat*)malloc(sizeof(GLfloat) *
-				     3 * (model->numvertices + 1));
-  model->triangles = (GLMtriangle*)malloc(sizeof(GLMtriangle) *
-					  model->numtriangles);
+  model->vertices = (GLfloat*)_glmAlloc(model, sizeof(GLfloat) *
+					 3 * (model->numvertices + 1));
+  model->triangles = (GLMtriangle*)_glmAlloc(model, sizeof(GLMtriangle) *
+					      model->numtriangles);
   if (model->numnormals) {
-    model->normals = (GLfloat*)malloc(sizeof(GLfloat) *
-				      3 * (model->numnormals + 1));
+    model->normals = (GLfloat*)_glmAlloc(model, sizeof(GLfloat) *
+					  3 * (model->numnormals + 1));
   }
   if (model->numtexcoords) {
-    model->texcoords = (GLfloat*)malloc(sizeof(GLfloat) *
-					2 * (model->numtexcoords + 1));
+    model->texcoords = (GLfloat*)_glmAlloc(model, sizeof(GLfloat) *
+					    2 * (model->numtexcoords + 1));
   }
 
   /* rewind to beginning of file and read in the data this pass */
@@ -1450,6 +2519,97 @@ glmReadOBJ(char* filename)
   return model;
 }
 
+/* glmReadOBJMapped: Reads a model description from a Wavefront .OBJ
+ * file like glmReadOBJ(), but maps the file into memory and parses it
+ * in a single pass with a hand-written tokenizer instead of going
+ * through fscanf() twice.  Big files are split at line boundaries and
+ * parsed on several threads.  Returns a pointer to the created object
+ * which should be free'd with glmDelete().
+ *
+ * filename   - name of the file containing the Wavefront .OBJ format data.  
+ * numthreads - number of parser threads, 0 = one per core
+ */
+GLMmodel* 
+glmReadOBJMapped(char* filename, GLuint numthreads)
+{
+  GLMmodel*  model;
+  MappedFile file;
+
+  /* map the file */
+  if (!file.open(filename)) {
+    fprintf(stderr, "glmReadOBJMapped() failed: can't open data file \"%s\".\n",
+	    filename);
+    exit(1);
+  }
+
+  if (numthreads == 0)
+    numthreads = thread::hardware_concurrency();
+  if (numthreads == 0)
+    numthreads = 1;
+
+  /* allocate a new model */
+  model = _glmNewModel(filename);
+
+  _glmChunkedPass(model, file.data(), file.size(), numthreads);
+
+  return model;
+}
+
+/* glmBenchmarkReadOBJ: Loads a Wavefront .OBJ file several times with
+ * glmReadOBJ() and glmReadOBJMapped() (one thread and one thread per
+ * core), prints the average load times and checks that all readers
+ * produce the same model.  Returns GL_TRUE if the models match.
+ *
+ * filename - name of the file containing the Wavefront .OBJ format data.  
+ * runs     - number of loads per reader
+ */
+GLboolean
+glmBenchmarkReadOBJ(char* filename, GLuint runs)
+{
+  typedef std::chrono::high_resolution_clock clock;
+  GLMmodel* models[3] = { NULL, NULL, NULL };
+  double    ms[3] = { 0.0, 0.0, 0.0 };
+  GLfloat   maxerror[3] = { 0.0f, 0.0f, 0.0f };
+  GLboolean match[3] = { GL_TRUE, GL_TRUE, GL_TRUE };
+  GLuint    numthreads;
+  GLuint    i, r;
+
+  numthreads = thread::hardware_concurrency();
+  if (numthreads == 0)
+    numthreads = 1;
+  if (runs == 0)
+    runs = 1;
+
+  for (r = 0; r < runs; r++) {
+    for (i = 0; i < 3; i++) {
+      clock::time_point start = clock::now();
+      GLMmodel* model = i == 0 ? glmReadOBJ(filename) :
+	glmReadOBJMapped(filename, i == 1 ? 1 : numthreads);
+      ms[i] += std::chrono::duration<double, std::milli>(clock::now() - start).count();
+      if (models[i]) glmDelete(models[i]);
+      models[i] = model;
+    }
+  }
+  for (i = 1; i < 3; i++)
+    match[i] = _glmCompareModels(models[0], models[i], &maxerror[i]);
+
+  printf("glmBenchmarkReadOBJ(): %s\n", filename);
+  printf(" %d vertices, %d normals, %d texcoords, %d triangles, %d groups\n",
+	 models[0]->numvertices, models[0]->numnormals, models[0]->numtexcoords,
+	 models[0]->numtriangles, models[0]->numgroups);
+  printf(" glmReadOBJ():                   %10.2f ms\n", ms[0] / runs);
+  for (i = 1; i < 3; i++) {
+    printf(" glmReadOBJMapped(), %2d threads: %10.2f ms (%.1fx), %s, max difference %g\n",
+	   i == 1 ? 1 : numthreads, ms[i] / runs, ms[i] > 0.0 ? ms[0] / ms[i] : 0.0,
+	   match[i] ? "match" : "DIFFER", maxerror[i]);
+  }
+
+  for (i = 0; i < 3; i++)
+    glmDelete(models[i]);
+
+  return match[1] && match[2];
+}
+
 /* glmWriteOBJ: Writes a model description in Wavefront .OBJ format to
  * a file.
  *
@@ -1808,52 +2968,132 @@ glmList(GLMmodel* model, GLuint mode)
   return list;
 }
 
+/* _glmApplyWeld: replace the vertices of the model by copies and
+ * point the triangles at them.
+ *
+ * model    - initialized GLMmodel structure
+ * remap    - copy index of every old vertex (1 .. model->numvertices)
+ * copies   - welded vertices, takes ownership
+ * numcopies - number of welded vertices
+ */
+static GLvoid
+_glmApplyWeld(GLMmodel* model, const GLuint* remap, GLfloat* copies, GLuint numcopies)
+{
+  GLuint i;
+
+  for (i = 0; i < model->numtriangles; i++) {
+    T(i).vindices[0] = remap[T(i).vindices[0]];
+    T(i).vindices[1] = remap[T(i).vindices[1]];
+    T(i).vindices[2] = remap[T(i).vindices[2]];
+  }
+
+  /* free space for old vertices */
+  _glmFree(model, model->vertices);
+
+  /* allocate space for the new vertices */
+  model->numvertices = numcopies;
+  model->vertices = (GLfloat*)_glmAlloc(model, sizeof(GLfloat) * 
+					 3 * (model->numvertices + 1));
+
+  /* copy the optimized vertices into the actual vertex list */
+  memcpy(model->vertices, copies, sizeof(GLfloat) * 3 * (model->numvertices + 1));
+  _glmTrackPeak(model, sizeof(GLfloat) * 3 * (numcopies + 1));
+
+  free(copies);
+}
+
 /* glmWeld: eliminate (weld) vectors that are within an epsilon of
- * each other.
+ * each other.  Uses a hashed grid, the result is the same as with the
+ * old quadratic search (see glmBenchmarkWeld()).
  *
  * model      - initialized GLMmodel structure
  * epsilon    - maximum difference between vertices
  *              ( 0.00001 is a good start for a unitized model)
- *
+ * numthreads - number of threads, 0 = one per core
  */
 GLvoid
-glmWeld(GLMmodel* model, GLfloat epsilon)
+glmWeld(GLMmodel* model, GLfloat epsilon, GLuint numthreads)
 {
-  GLfloat* vectors;
   GLfloat* copies;
   GLuint   numvectors;
-  GLuint   i;
 
   /* vertices */
   numvectors = model->numvertices;
-  vectors    = model->vertices;
-  copies = _glmWeldVectors(vectors, &numvectors, epsilon);
+  vector<GLuint> remap(numvectors + 1, 0);
+  copies = _glmWeldVectorsGrid(model->vertices, &numvectors, epsilon,
+			       numthreads, remap.data());
 
   printf("glmWeld(): %d redundant vertices.\n", 
-	 model->numvertices - numvectors - 1);
-
-  for (i = 0; i < model->numtriangles; i++) {
-    T(i).vindices[0] = (GLuint)vectors[3 * T(i).vindices[0] + 0];
-    T(i).vindices[1] = (GLuint)vectors[3 * T(i).vindices[1] + 0];
-    T(i).vindices[2] = (GLuint)vectors[3 * T(i).vindices[2] + 0];
-  }
-
-  /* free space for old vertices */
-  free(vectors);
+	 model->numvertices - numvectors);
 
-  /* allocate space for the new vertices */
-  model->numvertices = numvectors;
-  model->vertices = (GLfloat*)malloc(sizeof(GLfloat) * 
-				     3 * (model->numvertices + 1));
+  _glmApplyWeld(model, remap.data(), copies, numvectors);
+}
 
-  /* copy the optimized vertices into the actual vertex list */
-  for (i = 1; i <= model->numvertices; i++) {
-    model->vertices[3 * i + 0] = copies[3 * i + 0];
-    model->vertices[3 * i + 1] = copies[3 * i + 1];
-    model->vertices[3 * i + 2] = copies[3 * i + 2];
+/* glmBenchmarkWeld: Loads and unitizes a Wavefront .OBJ file, welds
+ * its vertices with the old quadratic _glmWeldVectors() and with
+ * glmWeld() (single and multi threaded), prints the time of each and
+ * checks that all produce the same vertices and triangles.  Returns
+ * GL_TRUE if they match.
+ *
+ * filename - name of the file containing the Wavefront .OBJ format data.
+ * epsilon  - maximum difference between vertices
+ */
+GLboolean
+glmBenchmarkWeld(char* filename, GLfloat epsilon)
+{
+  typedef std::chrono::high_resolution_clock clock;
+  GLMmodel* models[3] = { NULL, NULL, NULL };
+  double    ms[3] = { 0.0, 0.0, 0.0 };
+  GLfloat   maxerror[3] = { 0.0f, 0.0f, 0.0f };
+  GLboolean match[3] = { GL_TRUE, GL_TRUE, GL_TRUE };
+  GLuint    numvertices = 0;
+  GLuint    numthreads;
+  GLuint    i, v;
+
+  numthreads = thread::hardware_concurrency();
+  if (numthreads == 0)
+    numthreads = 1;
+
+  for (i = 0; i < 3; i++) {
+    models[i] = glmReadOBJMapped(filename);
+    glmUnitize(models[i]);
+    numvertices = models[i]->numvertices;
+
+    clock::time_point start = clock::now();
+    if (i == 0) {
+      /* reference: _glmWeldVectors() stores the copy index in the
+         first component of every vector */
+      GLuint numvectors = models[i]->numvertices;
+      GLfloat* copies = _glmWeldVectors(models[i]->vertices, &numvectors, epsilon);
+      vector<GLuint> remap(models[i]->numvertices + 1, 0);
+      for (v = 1; v <= models[i]->numvertices; v++)
+	remap[v] = (GLuint)models[i]->vertices[3 * v + 0];
+      _glmApplyWeld(models[i], remap.data(), copies, numvectors);
+    } else {
+      GLuint numvectors = models[i]->numvertices;
+      vector<GLuint> remap(numvectors + 1, 0);
+      GLfloat* copies = _glmWeldVectorsGrid(models[i]->vertices, &numvectors, epsilon,
+					    i == 1 ? 1 : numthreads, remap.data());
+      _glmApplyWeld(models[i], remap.data(), copies, numvectors);
+    }
+    ms[i] = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+  }
+  for (i = 1; i < 3; i++)
+    match[i] = _glmCompareModels(models[0], models[i], &maxerror[i]);
+
+  printf("glmBenchmarkWeld(): %s, epsilon %g\n", filename, epsilon);
+  printf(" %d vertices, %d after welding\n", numvertices, models[0]->numvertices);
+  printf(" _glmWeldVectors():        %10.2f ms\n", ms[0]);
+  for (i = 1; i < 3; i++) {
+    printf(" glmWeld(), %2d threads:    %10.2f ms (%.1fx), %s\n",
+	   i == 1 ? 1 : numthreads, ms[i], ms[i] > 0.0 ? ms[0] / ms[i] : 0.0,
+	   match[i] ? "match" : "DIFFER");
   }
 
-  free(copies);
+  for (i = 0; i < 3; i++)
+    glmDelete(models[i]);
+
+  return match[1] && match[2];
 }
 
 
@@ -65,11 +65,28 @@ typedef struct _GLMgroup {
   GLuint*           triangles;		/* array of triangle indices */
   GLuint            material;           /* index to material for group */
   struct _GLMgroup* next;		/* pointer to next group in model */
+  struct _GLMgroup* hashnext;		/* next group in the same hash bucket */
 } GLMgroup;
 
+/* GLMarena: Memory of a model.  Everything a model points to is cut
+ * out of a chain of blocks, so reading a model takes a few mallocs
+ * instead of one per group, name and array, and glmDelete() releases
+ * it all at once.
+ */
+typedef struct {
+  struct _GLMblock* blocks;		/* chain of blocks, newest first */
+  GLuint numallocs;			/* number of allocations served */
+  GLuint numblocks;			/* number of blocks malloc'ed */
+  size_t used;				/* bytes handed out */
+  size_t reserved;			/* bytes held in blocks */
+  size_t peak;				/* peak of reserved + temporaries */
+} GLMarena;
+
 /* GLMmodel: Structure that defines a model.
  */
 typedef struct {
+  GLMarena arena;			/* owns the memory of everything below */
+
   char*    pathname;			/* path to this model */
   char*    mtllibname;			/* name of the material library */
 
@@ -94,6 +111,11 @@ typedef struct {
   GLuint       numgroups;		/* number of groups in model */
   GLMgroup*    groups;			/* linked list of groups */
 
+  GLuint       numgroupbuckets;		/* size of the group hash table */
+  GLMgroup**   groupbuckets;		/* groups hashed by name */
+  GLuint       nummaterialbuckets;	/* size of the material hash table */
+  GLuint*      materialbuckets;		/* material index + 1 hashed by name, 0 = empty */
+
   GLfloat position[3];			/* position of the model */
 
 } GLMmodel;
@@ -157,12 +179,15 @@ glmFacetNormals(GLMmodel* model);
  * average normal calculation and the corresponding vertex is given
  * the facet normal.  This tends to preserve hard edges.  The angle to
  * use depends on the model, but 90 degrees is usually a good start.
+ * Vertices are processed in parallel, the result does not depend on
+ * the number of threads.
  *
- * model - initialized GLMmodel structure
- * angle - maximum angle (in degrees) to smooth across
+ * model      - initialized GLMmodel structure
+ * angle      - maximum angle (in degrees) to smooth across
+ * numthreads - number of threads, 0 = one per core
  */
 GLvoid
-glmVertexNormals(GLMmodel* model, GLfloat angle);
+glmVertexNormals(GLMmodel* model, GLfloat angle, GLuint numthreads = 1);
 
 /* glmLinearTexture: Generates texture coordinates according to a
  * linear projection of the texture map.  It generates these by
@@ -194,6 +219,14 @@ glmSpheremapTexture(GLMmodel* model);
 GLvoid
 glmDelete(GLMmodel* model);
 
+/* glmPrintMemory: Prints how many allocations the arena of a model
+ * served, in how many blocks, and the bytes used and at peak.
+ *
+ * model - initialized GLMmodel structure
+ */
+GLvoid
+glmPrintMemory(GLMmodel* model);
+
 /* glmReadOBJ: Reads a model description from a Wavefront .OBJ file.
  * Returns a pointer to the created object which should be free'd with
  * glmDelete().
@@ -203,6 +236,30 @@ glmDelete(GLMmodel* model);
 GLMmodel* 
 glmReadOBJ(char* filename);
 
+/* glmReadOBJMapped: Reads a model description from a Wavefront .OBJ
+ * file like glmReadOBJ(), but maps the file into memory and parses it
+ * in a single pass.  Big files are split at line boundaries and parsed
+ * on numthreads threads.  Fills the model exactly like glmReadOBJ().
+ * Returns a pointer to the created object which should be free'd with
+ * glmDelete().
+ *
+ * filename   - name of the file containing the Wavefront .OBJ format data.  
+ * numthreads - number of parser threads, 0 = one per core
+ */
+GLMmodel* 
+glmReadOBJMapped(char* filename, GLuint numthreads = 0);
+
+/* glmBenchmarkReadOBJ: Loads a Wavefront .OBJ file with glmReadOBJ()
+ * and glmReadOBJMapped() (single and multi threaded), prints the
+ * average load time of each and checks that all produce the same
+ * model.  Returns GL_TRUE if they match.
+ *
+ * filename - name of the file containing the Wavefront .OBJ format data.  
+ * runs     - number of loads per reader
+ */
+GLboolean
+glmBenchmarkReadOBJ(char* filename, GLuint runs);
+
 /* glmWriteOBJ: Writes a model description in Wavefront .OBJ format to
  * a file.
  *
@@ -247,12 +304,23 @@ GLuint
 glmList(GLMmodel* model, GLuint mode);
 
 /* glmWeld: eliminate (weld) vectors that are within an epsilon of
- * each other.
+ * each other.  Runs in expected linear time.
  *
  * model      - initialized GLMmodel structure
  * epsilon    - maximum difference between vertices
  *              ( 0.00001 is a good start for a unitized model)
- *
+ * numthreads - number of threads, 0 = one per core
  */
 GLvoid
-glmWeld(GLMmodel* model, GLfloat epsilon);
+glmWeld(GLMmodel* model, GLfloat epsilon, GLuint numthreads = 1);
+
+/* glmBenchmarkWeld: Loads and unitizes a Wavefront .OBJ file, welds
+ * it with the old quadratic search and with glmWeld() (single and
+ * multi threaded), prints the times and checks that all produce the
+ * same model.  Returns GL_TRUE if they match.
+ *
+ * filename - name of the file containing the Wavefront .OBJ format data.
+ * epsilon  - maximum difference between vertices
+ */
+GLboolean
+glmBenchmarkWeld(char* filename, GLfloat epsilon);
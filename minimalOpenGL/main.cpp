@@ -52,6 +52,13 @@
 // Uncomment to add VR support
 //#define _VR
 
+// Uncomment to print load times of the fscanf and the memory-mapped .obj readers
+//#define BENCHMARK_OBJ_LOADER
+// Uncomment to print vertex cache statistics (ACMR/ATVR) before and after mesh optimization
+//#define BENCHMARK_MESH_OPTIMIZER
+// Uncomment to compare glmWeld against the old quadratic vertex welding
+//#define BENCHMARK_WELD
+
 ////////////////////////////////////////////////////////////////////////////////
 
 #include "matrix.h"
@@ -62,6 +69,7 @@
 #include "Leap.h"
 #include "LeapHandler.h"
 #include "VCModels.h"
+#include "helper\TextureLoader.h"
 #include "helper\cPointToPointInterpolation.h"
 
 #ifdef _VR
@@ -107,6 +115,41 @@ int main(const int argc, const char* argv[]) {
     std::cout << "Minimal OpenGL 4.3 Example by Morgan McGuire\n\nW, A, S, D, C, Z keys to translate\nMouse click and drag to rotate\nESC to quit\n\n";
     std::cout << std::fixed;
 
+#   ifdef BENCHMARK_OBJ_LOADER
+    {
+        const char *benchObjs[] = { "assets/sphere.obj", "assets/body.obj",
+            "assets/Statue6.obj", "assets/lochstab_smaller.obj" };
+        for (auto obj : benchObjs) {
+            glmBenchmarkReadOBJ((char *)obj, 5);
+        }
+    }
+#   endif
+
+#   ifdef BENCHMARK_MESH_OPTIMIZER
+    {
+        const char *benchObjs[] = { "assets/sphere.obj", "assets/body.obj",
+            "assets/Statue6.obj", "assets/lochstab_smaller.obj" };
+        for (auto obj : benchObjs) {
+            VCWVObjModel::benchmarkMeshOptimizer(obj, VC_POS | VC_NORM | VC_TEX | VC_OPTIMIZE_OVERDRAW);
+        }
+        // triangle soups, one hard cluster per triangle for the overdraw pass
+        const char *facetedObjs[] = { "assets/body.obj", "assets/Statue6.obj" };
+        for (auto obj : facetedObjs) {
+            VCWVObjModel::benchmarkMeshOptimizer(obj, VC_POS | VC_NORM | VC_TEX | VC_OPTIMIZE_OVERDRAW, true);
+        }
+    }
+#   endif
+
+#   ifdef BENCHMARK_WELD
+    {
+        const char *benchObjs[] = { "assets/sphere.obj", "assets/body.obj",
+            "assets/Statue6.obj", "assets/lochstab_smaller.obj" };
+        for (auto obj : benchObjs) {
+            glmBenchmarkWeld((char *)obj, VC_WELD_EPSILON);
+        }
+    }
+#   endif
+
     uint32_t framebufferWidth = 1280, framebufferHeight = 720;
 #   ifdef _VR
         const int numEyes = 2;
@@ -127,6 +170,8 @@ int main(const int argc, const char* argv[]) {
 	// Initialize AntTweakBar
 	TwInit(TW_OPENGL_CORE, NULL);
 
+	initPerViewUniforms();
+
 	cameraPath = new cPointToPointInterpolation();
 
 	double lastTime = glfwGetTime();
@@ -169,12 +214,17 @@ int main(const int argc, const char* argv[]) {
 	glfwSetCharCallback(window, (GLFWcharfun)TwEventCharGLFW3);
 
     ENV_VAR.FULL_BODY_ON = false;
+    ENV_VAR.FRUSTUM_CULLING_ON = true;
+    // draw calls of both eyes in the last frame
+    TwAddVarRW(bar, "culling", TW_TYPE_BOOLCPP, &ENV_VAR.FRUSTUM_CULLING_ON, " label='Frustum culling' ");
+    TwAddVarRO(bar, "drawn", TW_TYPE_UINT32, &ENV_VAR.cullStats.drawn, " label='Draw calls' ");
+    TwAddVarRO(bar, "culled", TW_TYPE_UINT32, &ENV_VAR.cullStats.culled, " label='Culled draw calls' ");
 
     std::string _objPath{ "assets/quad.obj" };
     std::map<std::string, GLenum> _shaderPaths;
     _shaderPaths["shaders/simple_model.vert"] = GL_VERTEX_SHADER;
     _shaderPaths["shaders/simple_model.frag"] = GL_FRAGMENT_SHADER;
-    std::vector<std::string> _uniformNames = { "MVP", "leappos", "enhanced_texture" };
+    std::vector<std::string> _uniformNames = { "modelMat", "leapPos" };
     std::string _texPath{ "assets/hello.png" };
 	std::string _secondaryTexPath{ "assets/hello.png" };
     helloText = new VCText2D(_objPath, _shaderPaths, _uniformNames, _texPath);
@@ -193,11 +243,10 @@ int main(const int argc, const char* argv[]) {
     _shaderPaths.clear();
     _shaderPaths["shaders/Ch3D.vert"] = GL_VERTEX_SHADER;
     _shaderPaths["shaders/Ch3D.frag"] = GL_FRAGMENT_SHADER;
-    // uniform names "diffuse", "specular", "shininess", "emmissive", "ambient" in shader
-    // are used exclusively for data read from .mtl file if corresponding options 
-    // are turned on. More details in the definition of class VCWVObjModel
-    _uniformNames = { "MVP", "ModelMat", "normalMat", "camPos", "lightPos",
-        "diffuse", "specular", "shininess" };
+    // "diffuse", "specular", "shininess", "emmissive", "ambient" read from the .mtl file
+    // are in the Material uniform block if the corresponding options are turned on.
+    // More details in the definition of class VCWVObjModel
+    _uniformNames = { "modelMat", "normalMat" };
     chH = new VCCh3D(_objPath, _shaderPaths, _uniformNames);
     ENV_VAR.scene.push_back(chH);
     chH->translate(glm::vec3(0.f, 3.f, -5.f));
@@ -208,12 +257,12 @@ int main(const int argc, const char* argv[]) {
     sphereModel->translate(glm::vec3(3.f, 0.f, 1.f));
 	sphereModel->setScaleFactor(glm::vec3(0.1));
 
-    ENV_VAR.envMap.load("assets/envMap.jpg");
+    ENV_VAR.envMap.loadAsync("assets/envMap.jpg");
     _shaderPaths.clear();
     _shaderPaths["shaders/sphere_sky.vert"] = GL_VERTEX_SHADER;
     _shaderPaths["shaders/sphere_sky.tes"] = GL_TESS_EVALUATION_SHADER;
     _shaderPaths["shaders/sphere_sky.frag"] = GL_FRAGMENT_SHADER;
-    _uniformNames = {"MVP"};
+    _uniformNames = { "modelMat" };
     sphereSky = new SphereSky(_shaderPaths, _uniformNames, _objPath);
     ENV_VAR.scene.push_back(sphereSky);
     sphereSky->scale(glm::vec3(30));
@@ -230,8 +279,7 @@ int main(const int argc, const char* argv[]) {
     _shaderPaths.clear();
     _shaderPaths["shaders/body.vert"] = GL_VERTEX_SHADER;
     _shaderPaths["shaders/body.frag"] = GL_FRAGMENT_SHADER;
-    _uniformNames = { "MVP", "ModelMat", "normalMat", "camPos", "lightPos",
-        "diffuse", "specular", "shininess" };
+    _uniformNames = { "modelMat", "normalMat" };
     bodyModel = new VCCh3D(_objPath, _shaderPaths, _uniformNames);
     ENV_VAR.scene.push_back(bodyModel);
     bodyModel->scale(glm::vec3(5.f));
@@ -245,7 +293,7 @@ int main(const int argc, const char* argv[]) {
     _shaderPaths.clear();
     _shaderPaths["shaders/head.vert"] = GL_VERTEX_SHADER;
     _shaderPaths["shaders/head.frag"] = GL_FRAGMENT_SHADER;
-    _uniformNames = { "MVP", "ModelMat", "normalMat", "camPos", "lightPos", "leapPos" };
+    _uniformNames = { "modelMat", "normalMat", "leapPos" };
 
 #ifdef HEAD_MODEL
     headModel = new VCPSModel(_objPath, _shaderPaths, _uniformNames, ".png");
@@ -268,9 +316,10 @@ int main(const int argc, const char* argv[]) {
 #ifdef STICK_MODEL
     _objPath = std::string("assets/lochstab_smaller.obj");
     _shaderPaths.clear();
-    _shaderPaths["shaders/ps_model.vert"] = GL_VERTEX_SHADER;
+    // static mesh, drawn from the shared arena with multi draw indirect
+    _shaderPaths["shaders/ps_model_indirect.vert"] = GL_VERTEX_SHADER;
     _shaderPaths["shaders/ps_model.frag"] = GL_FRAGMENT_SHADER;
-    stickModel = new VCPSModel(_objPath, _shaderPaths, _uniformNames, ".jpg");
+    stickModel = new VCPSModel(_objPath, _shaderPaths, _uniformNames, ".jpg", VCPSMODEL_OPTION | VC_STATIC_ARENA);
 	std::string _epath{ "assets/stick_1_low_enhanced.jpg" };
 	stickModel->setEnhancedTexture(_epath);
     ENV_VAR.scene.push_back(stickModel);
@@ -279,6 +328,8 @@ int main(const int argc, const char* argv[]) {
     stickModel->translate(glm::vec3(0.f, 0.5f, -0.5f));
 #endif
 
+    VC_RESOURCES.printStats();
+
     
 
 
@@ -324,6 +375,9 @@ int main(const int argc, const char* argv[]) {
         vr::TrackedDevicePose_t trackedDevicePose[vr::k_unMaxTrackedDeviceCount];
 #   endif
 
+    // models submit their draw calls per eye, flushed once all are in
+    VCRenderQueue renderQueue;
+
     // Main loop:
     while (! glfwWindowShouldClose(window)) 
 	{
@@ -398,6 +452,11 @@ int main(const int argc, const char* argv[]) {
         glm::vec3 headPos(Matrix4x4ToGLM(headToWorldMatrix) * glm::vec4(0.f, 0.f, 0.f, 1.f));
         glm::vec3 camUp(0.f, 1.f, 0.f);
         helloText->alignToCamera(glm::vec3(viewDirWS), camUp);
+        // model and normal matrices of everything that moved this frame, in one batch
+        ENV_VAR.transforms.update();
+        // textures decoded in the background, a few ms per frame so loading doesn't stall the HMD
+        VC_TEXTURE_LOADER.update(2.0);
+        ENV_VAR.cullStats.drawn = ENV_VAR.cullStats.culled = 0;
 		// Draw the scene twice; for both eyes
         for (int eye = 0; eye < numEyes; ++eye) 
 		{
@@ -413,8 +472,11 @@ int main(const int argc, const char* argv[]) {
             glm::mat4 _projMat = Matrix4x4ToGLM(projectionMatrix[eye]);
 
             ENV_VAR.camPos = glm::vec3(_view2WorldMat * glm::vec4(0.f, 0.f, 0.f, 1.f));
+            // head light
+            ENV_VAR.lightPos = ENV_VAR.camPos;
             ENV_VAR.projMat = _projMat;
             ENV_VAR.viewMat = _viewMat;
+            updatePerViewUniforms();
 
             glBindFramebuffer(GL_FRAMEBUFFER, framebuffer[eye]);
             glViewport(0, 0, framebufferWidth, framebufferHeight);
@@ -432,24 +494,24 @@ int main(const int argc, const char* argv[]) {
 
 			//chH->rotate(scaledVel.x, glm::vec3(0, 0, 1));
 			//chH->draw();
-            // sphereSky->draw();
-            skySphere->draw();
+            // sphereSky->submit(renderQueue);
+            skySphere->submit(renderQueue);
 #ifdef HEAD_MODEL
 			headModel->rotate(scaledVel.x, glm::vec3(0, 0, 1));
-			headModel->draw();
+			headModel->submit(renderQueue);
             
 #endif
             if (ENV_VAR.FULL_BODY_ON) {
-                bodyModel->draw();
+                bodyModel->submit(renderQueue);
             }
 #ifdef STICK_MODEL
 			//stickModel->setLeapPosition(glm::vec3(palmPosition.x, palmPosition.y, palmPosition.z));
 			stickModel->setLeapPosition(scaledPos);
-            stickModel->draw();
+            stickModel->submit(renderQueue);
 #endif
 
 #ifdef DOLL_MODEL
-            dollModel->draw();
+            dollModel->submit(renderQueue);
 #endif
 
 
@@ -457,8 +519,11 @@ int main(const int argc, const char* argv[]) {
 
 			//sphereModel->setLeapPosition(glm::vec3(palmPosition.x, palmPosition.y, palmPosition.z));
 			sphereModel->setTranslation(scaledPos);
-            sphereModel->draw();
+            sphereModel->submit(renderQueue);
+            helloText->submit(renderQueue);
 
+            // sorted by state, blended packets (helloText) after the opaque ones, from back to front
+            renderQueue.flush();
             assert(glGetError() == GL_NONE);
 
             glDepthRange(0.9, 1.0);
@@ -466,9 +531,6 @@ int main(const int argc, const char* argv[]) {
             // it's really a creepy sky
             // sky->draw(framebufferWidth, framebufferHeight, cameraToWorldMatrix.data, projectionMatrix[eye].inverse().data, &light.x);
 
-            glDepthRange(0.0, 0.9);
-            // transparent objects should be draw at last, from back to front
-            helloText->draw();
             glDepthRange(0.0, 1.0);
 
 			// Draw the Anttweakbar UI
@@ -563,6 +625,10 @@ int main(const int argc, const char* argv[]) {
 
     delete sphereSky;
 	SAFE_DELETE(cameraPath);
+    renderQueue.release();
+    VCStaticArena::releaseAll();
+    VC_TEXTURE_LOADER.shutdown();
+    releasePerViewUniforms();
 
 	// Terminate AntTweakBar and GLFW
 	TwTerminate();
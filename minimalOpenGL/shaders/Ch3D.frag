@@ -1,13 +1,24 @@
 #version 430
 
-uniform vec3 camPos;
-uniform vec3 lightPos;
+// per view data, written once per eye (PerViewUniforms in helper/GLCommon.h)
+layout (std140, binding = 0) uniform PerView {
+	mat4 projMat;
+	mat4 viewMat;
+	mat4 viewProjMat;
+	vec3 camPos;
+	vec3 lightPos;
+};
 
 in vec3 vsWorldPos;
 in vec3 vsNormal;
-uniform vec4 diffuse;
-uniform vec4 specular;
-uniform float shininess;
+// material of the draw, one entry of the uniform buffer of the model (VCMtlUniforms in VCModels.h)
+layout (std140, binding = 1) uniform Material {
+	vec4 diffuse;
+	vec4 specular;
+	vec4 ambient;
+	vec4 emmissive;
+	float shininess;
+};
 
 out vec4 color;
 
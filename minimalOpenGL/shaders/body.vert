@@ -3,7 +3,15 @@
 layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 normal;
 
-uniform mat4 MVP;
+// per view data, written once per eye (PerViewUniforms in helper/GLCommon.h)
+layout (std140, binding = 0) uniform PerView {
+	mat4 projMat;
+	mat4 viewMat;
+	mat4 viewProjMat;
+	vec3 camPos;
+	vec3 lightPos;
+};
+
 uniform mat4 modelMat;
 uniform mat3 normalMat;
 
@@ -13,5 +21,5 @@ out vec3 vsNormal;
 void main () {
 	vsWorldPos = vec3(modelMat * vec4(position, 1.0));
 	vsNormal = normalMat * normal;
-	gl_Position = MVP * vec4 (position, 1.0);
+	gl_Position = viewProjMat * modelMat * vec4 (position, 1.0);
 }
\ No newline at end of file
@@ -2,8 +2,14 @@
 
 layout(binding = 0) uniform sampler2D diffuseTex;
 
-uniform vec3 camPos;
-uniform vec3 lightPos;
+// per view data, written once per eye (PerViewUniforms in helper/GLCommon.h)
+layout (std140, binding = 0) uniform PerView {
+	mat4 projMat;
+	mat4 viewMat;
+	mat4 viewProjMat;
+	vec3 camPos;
+	vec3 lightPos;
+};
 uniform vec4 leapPos;
 
 
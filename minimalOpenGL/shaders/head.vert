@@ -1,10 +1,19 @@
 #version 430
 
 layout (location = 0) in vec3 position;
-layout (location = 1) in vec3 normal;
+// octahedral encoded, VCPSModel uploads normals with VC_NORM_OCT
+layout (location = 1) in vec2 normal;
 layout (location = 2) in vec2 texCoord;
 
-uniform mat4 MVP;
+// per view data, written once per eye (PerViewUniforms in helper/GLCommon.h)
+layout (std140, binding = 0) uniform PerView {
+	mat4 projMat;
+	mat4 viewMat;
+	mat4 viewProjMat;
+	vec3 camPos;
+	vec3 lightPos;
+};
+
 uniform mat4 modelMat;
 uniform mat3 normalMat;
 
@@ -12,9 +21,15 @@ out vec3 vsWorldPos;
 out vec3 vsNormal;
 out vec2 vsTexCoord;
 
+vec3 octDecode(vec2 e) {
+	vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (v.z < 0.0) v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+	return normalize(v);
+}
+
 void main () {
 	vsWorldPos = vec3(modelMat * vec4(position, 1.0));
-	vsNormal = normalMat * normal;
+	vsNormal = normalMat * octDecode(normal);
     vsTexCoord = texCoord;
-	gl_Position = MVP * vec4 (position, 1.0);
+	gl_Position = viewProjMat * modelMat * vec4 (position, 1.0);
 }
\ No newline at end of file
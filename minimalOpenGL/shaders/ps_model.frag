@@ -3,14 +3,20 @@
 layout(binding = 0) uniform sampler2D diffuseTex;
 layout(binding = 3) uniform sampler2D enhancedTex;
 
-uniform vec3 camPos;
-uniform vec3 lightPos;
-uniform vec4 leapPos;
+// per view data, written once per eye (PerViewUniforms in helper/GLCommon.h)
+layout (std140, binding = 0) uniform PerView {
+	mat4 projMat;
+	mat4 viewMat;
+	mat4 viewProjMat;
+	vec3 camPos;
+	vec3 lightPos;
+};
 
 
 in vec3 vsWorldPos;
 in vec3 vsNormal;
 in vec2 vsTexCoord;
+flat in vec4 vsLeapPos;
 
 
 out vec4 color;
@@ -23,7 +29,7 @@ vec3 lighting()
     vec3 R = reflect(-L, N);
     
 	vec3 texColor;
-	vec3 leap = vec3(leapPos.x, leapPos.y, leapPos.z);
+	vec3 leap = vec3(vsLeapPos.x, vsLeapPos.y, vsLeapPos.z);
 	
 	float dis = distance(leap, vsWorldPos);
 
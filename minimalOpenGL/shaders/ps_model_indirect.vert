@@ -0,0 +1,48 @@
+#version 430
+
+// ps_model.vert for models loaded with VC_STATIC_ARENA, drawn by glMultiDrawElementsIndirect
+layout (location = 0) in vec3 position;
+// octahedral encoded, VCPSModel uploads normals with VC_NORM_OCT
+layout (location = 1) in vec2 normal;
+layout (location = 2) in vec2 texCoord;
+// entry in drawData, the base instance of the indirect command (VC_DRAW_ID_LOCATION in VCStaticArena.h)
+layout (location = 7) in uint drawID;
+
+// per view data, written once per eye (PerViewUniforms in helper/GLCommon.h)
+layout (std140, binding = 0) uniform PerView {
+	mat4 projMat;
+	mat4 viewMat;
+	mat4 viewProjMat;
+	vec3 camPos;
+	vec3 lightPos;
+};
+
+// per draw data, written once per flush (VCDrawData in VCRenderQueue.h)
+struct DrawData {
+	mat4 modelMat;
+	mat3 normalMat;
+	vec4 leapPos;
+};
+layout (std430, binding = 2) readonly buffer DrawDataBlock {
+	DrawData drawData[];
+};
+
+out vec3 vsWorldPos;
+out vec3 vsNormal;
+out vec2 vsTexCoord;
+flat out vec4 vsLeapPos;
+
+vec3 octDecode(vec2 e) {
+	vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (v.z < 0.0) v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+	return normalize(v);
+}
+
+void main () {
+	mat4 modelMat = drawData[drawID].modelMat;
+	vsWorldPos = vec3(modelMat * vec4(position, 1.0));
+	vsNormal = drawData[drawID].normalMat * octDecode(normal);
+	vsTexCoord = texCoord;
+	vsLeapPos = drawData[drawID].leapPos;
+	gl_Position = viewProjMat * vec4(vsWorldPos, 1.0);
+}
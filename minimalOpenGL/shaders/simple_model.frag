@@ -5,7 +5,7 @@ layout(binding = 3) uniform sampler2D texture_enhanced;
 
 
 in vec2 texcoords;
-uniform vec4 leappos;
+uniform vec4 leapPos;
 
 // uniform samplerCube cube_texture;
 out vec4 frag_colour;
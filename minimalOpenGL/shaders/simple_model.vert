@@ -3,12 +3,21 @@
 layout (location = 0) in vec3 position;
 layout (location = 1) in vec2 uv;
 
-uniform mat4 MVP;
+// per view data, written once per eye (PerViewUniforms in helper/GLCommon.h)
+layout (std140, binding = 0) uniform PerView {
+	mat4 projMat;
+	mat4 viewMat;
+	mat4 viewProjMat;
+	vec3 camPos;
+	vec3 lightPos;
+};
+
+uniform mat4 modelMat;
 
 out vec2 texcoords;
 
 void main () {
 	texcoords = uv;
 	
-	gl_Position = MVP * vec4 (position, 1.0);
+	gl_Position = viewProjMat * modelMat * vec4 (position, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,181 @@
+/*
+*  mipcheck loads images through every OGLTexture mipmap path and compares the levels
+*  the GL ended up with against vcDownsample() of the flipped image.
+*
+*      mipcheck [<image>...]      (assets/hello.png and assets/generator_diffuse.jpg by default)
+*
+*  Per image it loads OGL_MIPMAPS_GPU and OGL_MIPMAPS_CPU through OGLTexture::load() and both
+*  again through loadAsync(). Every texture must have the full chain with the right sizes,
+*  level 0 must equal the flipped image and levels >= 1 must be within 1 of the reference in
+*  every channel. The OGL_MIPMAPS_CPU levels are checked against vcDownsample() of the whole
+*  image; glGenerateMipmap filters each level from the rounded one above it, so that drifts a
+*  few steps by the last level and the GPU levels are checked against vcDownsample() of the
+*  level above as the GL holds it. Prints each mismatch and exits with 1 if there was any,
+*  run it from minimalOpenGL/ after touching the upload or mipmap code.
+*
+*  The context is surfaceless (EGL) where EGL is around, a hidden GLFW window on Windows.
+*/
+
+#include "../../helper/Mipmaps.h"
+#include "../../helper/OGLTexture.h"
+#include "../../helper/TextureLoader.h"
+#include "../../helper/stbi_image/stb_image.h"
+#include <algorithm>
+#include <iostream>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+namespace {
+
+bool
+createContext()
+{
+#ifdef _WIN32
+    if (!glfwInit()) return false;
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    GLFWwindow *window = glfwCreateWindow(16, 16, "mipcheck", nullptr, nullptr);
+    if (!window) return false;
+    glfwMakeContextCurrent(window);
+#else
+    auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (!getPlatformDisplay) return false;
+    EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    EGLint major, minor;
+    if (!eglInitialize(display, &major, &minor) || !eglBindAPI(EGL_OPENGL_API)) return false;
+    const EGLint attribs[] = { EGL_CONTEXT_MAJOR_VERSION, 4, EGL_CONTEXT_MINOR_VERSION, 5,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE };
+    EGLContext context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attribs);
+    if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) return false;
+#endif
+    glewExperimental = GL_TRUE;
+    glewInit();
+    // glewInit() may leave an error behind in a core context
+    while (glGetError() != GL_NO_ERROR);
+    return true;
+}
+
+// level 0 exact, the others within _tolerance per channel of _expected, or of the first level
+// vcDownsample() makes from the texture's level above with _fromLevelAbove.
+// Returns the number of mismatching levels
+int
+checkTexture(const std::string &_name, OGLTexture &_texture, const std::vector<std::vector<unsigned char>> &_expected,
+    int _width, int _height, int _tolerance, bool _fromLevelAbove)
+{
+    int mismatches = 0;
+    GLint numLevels = 0;
+    _texture.bind();
+    for (;; ++numLevels) {
+        GLint w = 0;
+        glGetTexLevelParameteriv(_texture.getTarget(), numLevels, GL_TEXTURE_WIDTH, &w);
+        if (!w) break;
+    }
+    if (numLevels != (GLint)_expected.size()) {
+        std::cerr << "MISMATCH " << _name << ": " << numLevels << " levels, expected " << _expected.size() << std::endl;
+        return 1;
+    }
+
+    std::vector<unsigned char> pixels, levelAbove;
+    for (GLint level = 0; level < numLevels; ++level) {
+        GLint w = 0, h = 0;
+        glGetTexLevelParameteriv(_texture.getTarget(), level, GL_TEXTURE_WIDTH, &w);
+        glGetTexLevelParameteriv(_texture.getTarget(), level, GL_TEXTURE_HEIGHT, &h);
+        if (w != std::max(1, _width >> level) || h != std::max(1, _height >> level)) {
+            std::cerr << "MISMATCH " << _name << ": level " << level << " is " << w << "x" << h << std::endl;
+            ++mismatches;
+            continue;
+        }
+        pixels.resize((size_t)w * h * 4);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glGetTexImage(_texture.getTarget(), level, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        std::vector<unsigned char> reference;
+        if (level && _fromLevelAbove) {
+            reference = vcDownsample(levelAbove.data(), std::max(1, _width >> (level - 1)),
+                std::max(1, _height >> (level - 1))).front();
+        }
+        const std::vector<unsigned char> &expected = reference.empty() ? _expected[level] : reference;
+        int maxDiff = 0;
+        for (size_t i = 0; i < pixels.size(); ++i) {
+            maxDiff = std::max(maxDiff, abs(int(pixels[i]) - int(expected[i])));
+        }
+        levelAbove.swap(pixels);
+        if (maxDiff > (level ? _tolerance : 0)) {
+            std::cerr << "MISMATCH " << _name << ": level " << level << " (" << w << "x" << h
+                << ") is off by up to " << maxDiff << std::endl;
+            ++mismatches;
+        }
+    }
+    return mismatches;
+}
+
+int
+checkImage(const char *_path)
+{
+    int w = 0, h = 0, n = 0;
+    unsigned char *image = stbi_load(_path, &w, &h, &n, 4);
+    if (!image) {
+        std::cerr << "MISMATCH " << _path << ": can't load" << std::endl;
+        return 1;
+    }
+    // bottom row first, as OGLTexture uploads it
+    size_t rowBytes = (size_t)w * 4;
+    std::vector<std::vector<unsigned char>> expected(1, std::vector<unsigned char>(rowBytes * h));
+    for (int y = 0; y < h; ++y) {
+        memcpy(&expected[0][y * rowBytes], image + (size_t)(h - 1 - y) * rowBytes, rowBytes);
+    }
+    stbi_image_free(image);
+    std::vector<std::vector<unsigned char>> mipmaps = vcDownsample(expected[0].data(), w, h);
+    expected.insert(expected.end(), mipmaps.begin(), mipmaps.end());
+
+    OGLTexture gpu, cpu, gpuAsync, cpuAsync;
+    cpu.setFiltering(OGL_MIPMAPS_CPU, 8.f);
+    cpuAsync.setFiltering(OGL_MIPMAPS_CPU, 8.f);
+    std::vector<char> path(_path, _path + strlen(_path) + 1);
+    gpu.load(path.data());
+    cpu.load(path.data());
+    gpuAsync.loadAsync(_path);
+    cpuAsync.loadAsync(_path);
+    while (VC_TEXTURE_LOADER.numPending()) VC_TEXTURE_LOADER.update(1000.0);
+
+    int mismatches = 0;
+    GLenum error = glGetError();
+    if (error != GL_NO_ERROR) {
+        std::cerr << "MISMATCH " << _path << ": GL error 0x" << std::hex << error << std::dec << std::endl;
+        ++mismatches;
+    }
+    std::string name(_path);
+    mismatches += checkTexture(name + " gpu", gpu, expected, w, h, 1, true);
+    mismatches += checkTexture(name + " cpu", cpu, expected, w, h, 1, false);
+    mismatches += checkTexture(name + " gpu async", gpuAsync, expected, w, h, 1, true);
+    mismatches += checkTexture(name + " cpu async", cpuAsync, expected, w, h, 1, false);
+    std::cout << _path << ": " << w << "x" << h << ", " << expected.size() << " levels, "
+        << (mismatches ? "FAILED" : "ok") << std::endl;
+    return mismatches;
+}
+
+} // namespace
+
+int
+main(int argc, char *argv[])
+{
+    if (!createContext()) {
+        std::cerr << "can't create a GL context" << std::endl;
+        return 1;
+    }
+    std::vector<const char *> images(argv + 1, argv + argc);
+    if (images.empty()) images = { "assets/hello.png", "assets/generator_diffuse.jpg" };
+
+    int mismatches = 0;
+    for (auto image : images) mismatches += checkImage(image);
+    VC_TEXTURE_LOADER.shutdown();
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,147 @@
+/*
+*  texcompress encodes textures into BC1/BC3 mip chains in .dds files for
+*  OGLTexture::loadCompressed().
+*
+*      texcompress [-bc1 | -bc3] [-o <dir>] <image>...
+*
+*  Without -bc1/-bc3 an image with any alpha below 255 becomes BC3, every other one BC1.
+*  Each .dds is written next to its image (or into <dir>) with the extension replaced.
+*  VCWVObjModel loads it instead of the image as long as it isn't older than the image.
+*  The mipmaps are box filtered like OGL_MIPMAPS_CPU, every level is encoded on all cores.
+*  Wildcards are expanded by the shell, or by setargv.obj on Windows.
+*/
+
+#include "../../helper/BCnTexture.h"
+#include "../../helper/Mipmaps.h"
+#include "../../helper/stbi_image/stb_image.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+void
+usage()
+{
+    std::cerr << "usage: texcompress [-bc1 | -bc3] [-o <dir>] <image>..." << std::endl;
+}
+
+std::string
+ddsPath(const std::string &_imagePath, const std::string &_outDir)
+{
+    std::string path = _imagePath;
+    auto const dotPos = path.find_last_of('.');
+    auto const slashPos = path.find_last_of("/\\");
+    if (dotPos != std::string::npos && (slashPos == std::string::npos || dotPos > slashPos)) path.erase(dotPos);
+    if (!_outDir.empty()) {
+        path = _outDir + "/" + (slashPos == std::string::npos ? path : path.substr(slashPos + 1));
+    }
+    return path + ".dds";
+}
+
+// one level on all cores, each thread takes an equal share of the block rows
+std::vector<unsigned char>
+encodeLevel(VCBCnFormat _format, const unsigned char *_pixels, int _width, int _height)
+{
+    std::vector<unsigned char> blocks(vcBCnLevelSize(_format, _width, _height));
+    int blockRows = (_height + 3) / 4;
+    int numThreads = std::max(1, std::min((int)std::thread::hardware_concurrency(), blockRows));
+    std::vector<std::thread> threads;
+    for (int i = 0; i < numThreads; ++i) {
+        int first = blockRows * i / numThreads, end = blockRows * (i + 1) / numThreads;
+        threads.push_back(std::thread([=, &blocks]() {
+            vcEncodeBCn(_format, _pixels, _width, _height, blocks.data(), first, end);
+        }));
+    }
+    for (auto &thread : threads) thread.join();
+    return blocks;
+}
+
+bool
+compress(const std::string &_imagePath, const std::string &_outDir, int _forcedFormat)
+{
+    auto startTime = std::chrono::high_resolution_clock::now();
+    int w = 0, h = 0, n = 0;
+    unsigned char *image = stbi_load(_imagePath.c_str(), &w, &h, &n, 4);
+    if (!image) {
+        std::cerr << "can't load " << _imagePath << std::endl;
+        return false;
+    }
+
+    // bottom row first, as OGLTexture::load() uploads images
+    size_t rowBytes = (size_t)w * 4;
+    std::vector<unsigned char> pixels(rowBytes * h);
+    for (int y = 0; y < h; ++y) {
+        memcpy(&pixels[y * rowBytes], image + (size_t)(h - 1 - y) * rowBytes, rowBytes);
+    }
+    stbi_image_free(image);
+
+    VCBCnFormat format = VC_BC1;
+    if (_forcedFormat >= 0) {
+        format = VCBCnFormat(_forcedFormat);
+    }
+    else {
+        for (size_t i = 3; i < pixels.size(); i += 4) {
+            if (pixels[i] != 255) {
+                format = VC_BC3;
+                break;
+            }
+        }
+    }
+
+    std::vector<std::vector<unsigned char>> mipmaps = vcDownsample(pixels.data(), w, h);
+    std::vector<std::vector<unsigned char>> levels;
+    levels.push_back(encodeLevel(format, pixels.data(), w, h));
+    for (size_t i = 0; i < mipmaps.size(); ++i) {
+        levels.push_back(encodeLevel(format, mipmaps[i].data(), std::max(1, w >> (i + 1)), std::max(1, h >> (i + 1))));
+    }
+
+    std::string outPath = ddsPath(_imagePath, _outDir);
+    if (!vcWriteDDS(outPath, format, w, h, levels)) {
+        std::cerr << "can't write " << outPath << std::endl;
+        return false;
+    }
+    size_t rawBytes = pixels.size(), compressedBytes = 0;
+    for (auto &mipmap : mipmaps) rawBytes += mipmap.size();
+    for (auto &level : levels) compressedBytes += level.size();
+    std::cout << _imagePath << " -> " << outPath << ": " << (format == VC_BC1 ? "BC1 " : "BC3 ")
+        << w << "x" << h << ", " << levels.size() << " levels, " << rawBytes << " -> " << compressedBytes
+        << " bytes in " << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count()
+        << " ms" << std::endl;
+    return true;
+}
+
+} // namespace
+
+int
+main(int argc, char *argv[])
+{
+    int forcedFormat = -1;
+    std::string outDir;
+    std::vector<std::string> images;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg(argv[i]);
+        if (arg == "-bc1") forcedFormat = VC_BC1;
+        else if (arg == "-bc3") forcedFormat = VC_BC3;
+        else if (arg == "-o" && i + 1 < argc) outDir = argv[++i];
+        else if (!arg.empty() && arg[0] == '-') {
+            usage();
+            return 1;
+        }
+        else images.push_back(arg);
+    }
+    if (images.empty()) {
+        usage();
+        return 1;
+    }
+
+    int failed = 0;
+    for (auto &image : images) {
+        if (!compress(image, outDir, forcedFormat)) ++failed;
+    }
+    return failed ? 1 : 0;
+}